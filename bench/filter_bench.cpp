@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+#include "opencv2/core/utils/logger.hpp"
+
+#include "../lab2/filters.h"
+#include "../lab2/filter_graph.h"
+#include "../lab4/fourier.h"
+
+
+// Benchmarks the lab2 filters and the lab4 Fourier code over a matrix of image sizes,
+// kernel sizes and thread counts. Every case is warmed up, then timed `repetitions`
+// times; the median and the median absolute deviation are reported. Results can be
+// written as JSON and compared against a previously written file:
+//
+//   filter_bench --json base.json
+//   filter_bench --baseline base.json --tolerance 0.1   (exits with 1 on a slowdown)
+
+struct BenchOptions {
+    std::string image;     // source image, random noise when empty
+    std::string json;      // where to write the results
+    std::string baseline;  // results to compare against
+    std::string filter;    // only cases whose name contains this
+    double tolerance = 0.1;
+    int repetitions = 15;
+    int warmup = 3;
+    bool quick = false;
+};
+
+struct BenchResult {
+    std::string name;
+    double median = 0, mad = 0;  // milliseconds
+    int repetitions = 0;
+};
+
+inline BenchOptions parse_bench_options(int argc, char **argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--image" && has_value) {
+            options.image = argv[++i];
+        } else if (arg == "--json" && has_value) {
+            options.json = argv[++i];
+        } else if (arg == "--baseline" && has_value) {
+            options.baseline = argv[++i];
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--tolerance" && has_value) {
+            options.tolerance = std::stod(argv[++i]);
+        } else if (arg == "--repetitions" && has_value) {
+            options.repetitions = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--warmup" && has_value) {
+            options.warmup = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--quick") {
+            options.quick = true;
+        } else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+        }
+    }
+    return options;
+}
+
+inline double median_of(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : 0.5 * (values[mid - 1] + values[mid]);
+}
+
+class Bench {
+    const BenchOptions &options;
+
+public:
+    std::vector<BenchResult> results;
+
+    explicit Bench(const BenchOptions &options) : options(options) {}
+
+    void run(const std::string &name, const std::function<cv::Mat()> &func);
+};
+
+inline void Bench::run(const std::string &name, const std::function<cv::Mat()> &func) {
+    using clock = std::chrono::steady_clock;
+    using ms = std::chrono::duration<double, std::milli>;
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return;
+
+    // Keeping the last result alive stops the calls from being optimized away and
+    // keeps the allocation pattern the same in every repetition
+    cv::Mat sink;
+    for (int i = 0; i < options.warmup; i++) {
+        sink = func();
+    }
+    std::vector<double> samples(options.repetitions);
+    for (double &sample: samples) {
+        auto start = clock::now();
+        sink = func();
+        sample = ms(clock::now() - start).count();
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.repetitions = options.repetitions;
+    result.median = median_of(samples);
+    for (double &sample: samples) sample = std::abs(sample - result.median);
+    result.mad = median_of(samples);
+    results.push_back(result);
+
+    std::cout << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << result.median << " ms  +- " << result.mad << std::endl;
+}
+
+
+inline std::string case_name(const std::string &func, cv::Size size, int ksize, int threads) {
+    std::string name = func + "/" + std::to_string(size.width) + "x" + std::to_string(size.height);
+    if (ksize > 0) name += "/k" + std::to_string(ksize);
+    return name + "/t" + std::to_string(threads);
+}
+
+inline cv::Mat make_image(const BenchOptions &options, cv::Size size) {
+    cv::Mat image;
+    if (!options.image.empty()) {
+        cv::Mat source = cv::imread(options.image, cv::IMREAD_GRAYSCALE);
+        if (!source.empty()) cv::resize(source, image, size);
+    }
+    if (image.empty()) {
+        image.create(size, CV_8UC1);
+        cv::RNG rng(1);
+        rng.fill(image, cv::RNG::UNIFORM, 0, 256);
+    }
+    return image;
+}
+
+inline void run_filter_cases(Bench &bench, const BenchOptions &options, const std::vector<int> &thread_counts) {
+    std::vector<int> sizes = options.quick ? std::vector<int>{256, 512} : std::vector<int>{256, 512, 1024, 2048};
+    std::vector<int> ksizes = options.quick ? std::vector<int>{3, 7} : std::vector<int>{3, 5, 7, 15};
+
+    for (int side: sizes) {
+        cv::Size size(side, side);
+        cv::Mat image = make_image(options, size);
+        for (int threads: thread_counts) {
+            cv::setNumThreads(threads);
+            for (int k: ksizes) {
+                bench.run(case_name("box_filter", size, k, threads), [&] { return box_filter(image, k); });
+                bench.run(case_name("box_filter_fast", size, k, threads), [&] { return box_filter_fast(image, k); });
+                bench.run(case_name("cv_blur", size, k, threads), [&] {
+                    cv::Mat result;
+                    cv::blur(image, result, {k, k});
+                    return result;
+                });
+                bench.run(case_name("laplace_filter", size, k, threads), [&] { return laplace_filter(image, k); });
+                bench.run(case_name("unsharp_box", size, k, threads),
+                          [&] { return fused_unsharp_box(image, k, 0.5); });
+                bench.run(case_name("unsharp_gaussian", size, k, threads),
+                          [&] { return fused_unsharp_gaussian(image, k, 0.5); });
+                bench.run(case_name("unsharp_laplace", size, k, threads),
+                          [&] { return fused_unsharp_laplace(image, k, 0.3); });
+                if (k <= FIXED_MAX_KSIZE) {
+                    bench.run(case_name("box_filter_fixed", size, k, threads),
+                              [&] { return box_filter_fixed(image, k); });
+                    bench.run(case_name("laplace_filter_fixed", size, k, threads),
+                              [&] { return laplace_filter_fixed(image, k); });
+                    bench.run(case_name("unsharp_fixed", size, k, threads),
+                              [&] { return unsharp_mask_fixed(image, k, 0.5); });
+
+                    // The lab2 difference display: log_amplify(|box - gaussian|), eager and as a graph
+                    bench.run(case_name("pipeline_eager", size, k, threads), [&] {
+                        cv::Mat gaussian;
+                        cv::GaussianBlur(image, gaussian, {k, k}, 0);
+                        return log_amplify(img_diff(box_filter_fixed(image, k), gaussian));
+                    });
+                    FilterGraph graph;
+                    FilterGraph::Node src = graph.input(image);
+                    FilterGraph::Node diff = graph.log_amplify(graph.absdiff(graph.box(src, k), graph.gaussian(src, k)));
+                    // Evaluating into the same outputs reuses their buffers
+                    std::vector<cv::Mat> outputs;
+                    bench.run(case_name("pipeline_graph", size, k, threads), [&] {
+                        graph.evaluate({diff}, outputs);
+                        return outputs[0];
+                    });
+                }
+            }
+            // The recursive Gaussian costs the same for every sigma, the FIR one grows linearly
+            for (int sigma: {2, 8, 32}) {
+                std::string suffix = "_s" + std::to_string(sigma);
+                bench.run(case_name("iir_gaussian" + suffix, size, 0, threads),
+                          [&] { return iir_gaussian_blur(image, sigma); });
+                bench.run(case_name("unsharp_iir" + suffix, size, 0, threads),
+                          [&] { return unsharp_mask_iir(image, sigma, 0.5); });
+                bench.run(case_name("cv_gaussian" + suffix, size, 0, threads), [&] {
+                    cv::Mat result;
+                    cv::GaussianBlur(image, result, {0, 0}, sigma, sigma, cv::BORDER_REPLICATE);
+                    return result;
+                });
+            }
+        }
+    }
+}
+
+inline void run_fourier_cases(Bench &bench, const BenchOptions &options, const std::vector<int> &thread_counts) {
+    // Power of two sides, so the recursive baseline can run too
+    std::vector<int> sizes = options.quick ? std::vector<int>{128, 256} : std::vector<int>{128, 256, 512, 1024};
+    std::vector<int> ksizes = options.quick ? std::vector<int>{3} : std::vector<int>{3, 15};
+
+    for (int side: sizes) {
+        cv::Size size(side, side);
+        cv::Mat image = make_image(options, size);
+        std::vector<std::complex<double>> samples = mat2vec(image), spectrum;
+        for (int threads: thread_counts) {
+            cv::setNumThreads(threads);
+            bench.run(case_name("fft_recursive", size, 0, threads), [&] {
+                fft_radix2_recursive(samples, spectrum, false);
+                return cv::Mat();
+            });
+            bench.run(case_name("fft_radix2", size, 0, threads), [&] {
+                fft_radix2(samples, spectrum, false);
+                return cv::Mat();
+            });
+            bench.run(case_name("fft2d", size, 0, threads), [&] { return fft2d(image); });
+            bench.run(case_name("rfft2d", size, 0, threads), [&] { return rfft2d(image); });
+            bench.run(case_name("cv_dft", size, 0, threads), [&] {
+                cv::Mat float_image, result;
+                image.convertTo(float_image, CV_32F);
+                cv::dft(float_image, result, cv::DFT_COMPLEX_OUTPUT);
+                return result;
+            });
+            for (int k: ksizes) {
+                cv::Mat kernel = cv::Mat::ones(k, k, CV_64F) / (k * k);
+                cv::Size transform_size = convolution_size(image, kernel);
+                bench.run(case_name("convolution", size, k, threads),
+                          [&] { return convolution(image, kernel, transform_size); });
+            }
+        }
+    }
+
+    // OCR-style search: four 32x24 templates against one image, one call each against a shared matcher
+    for (int side: sizes) {
+        cv::Size size(side, side);
+        cv::Mat image = make_image(options, size);
+        std::vector<cv::Mat> templates;
+        for (int i = 0; i < 4; i++) templates.push_back(image(cv::Rect(i * 8, i * 8, 24, 32)).clone());
+        for (int threads: thread_counts) {
+            cv::setNumThreads(threads);
+            bench.run(case_name("correlation_x4", size, 0, threads), [&] {
+                cv::Mat result;
+                for (const cv::Mat &templ: templates) correlation(image, templ, result);
+                return result;
+            });
+            bench.run(case_name("template_matcher_x4", size, 0, threads), [&] {
+                return TemplateMatcher(image).correlate(templates).back();
+            });
+        }
+    }
+
+    // Sizes the recursion cannot take: mixed radix (480 = 2^5 * 3 * 5) and Bluestein (499 is prime)
+    for (int side: {480, 499}) {
+        cv::Size size(side, side);
+        cv::Mat image = make_image(options, size);
+        for (int threads: thread_counts) {
+            cv::setNumThreads(threads);
+            bench.run(case_name("fft2d", size, 0, threads), [&] { return fft2d(image); });
+            bench.run(case_name("cv_dft_64f", size, 0, threads), [&] {
+                cv::Mat double_image, result;
+                image.convertTo(double_image, CV_64F);
+                cv::dft(double_image, result, cv::DFT_COMPLEX_OUTPUT);
+                return result;
+            });
+        }
+    }
+
+    // One large frame, to see how the 2D transform scales with threads
+    if (!options.quick) {
+        cv::Size size(4096, 4096);
+        cv::Mat image = make_image(options, size);
+        for (int threads: thread_counts) {
+            cv::setNumThreads(threads);
+            bench.run(case_name("fft2d", size, 0, threads), [&] { return fft2d(image); });
+            bench.run(case_name("cv_dft_64f", size, 0, threads), [&] {
+                cv::Mat double_image, result;
+                image.convertTo(double_image, CV_64F);
+                cv::dft(double_image, result, cv::DFT_COMPLEX_OUTPUT);
+                return result;
+            });
+        }
+    }
+
+    // The direct DFT is O(N^2) in the number of pixels, only tiny images are feasible
+    for (int side: {16, 32}) {
+        cv::Size size(side, side);
+        cv::Mat image = make_image(options, size);
+        bench.run(case_name("dft", size, 0, 1), [&] { return dft(image); });
+    }
+}
+
+
+inline bool write_results(const std::string &path, const std::vector<BenchResult> &results) {
+    cv::FileStorage file(path, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON);
+    if (!file.isOpened()) return false;
+    file << "results" << "[";
+    for (const BenchResult &result: results) {
+        file << "{" << "name" << result.name << "median_ms" << result.median << "mad_ms" << result.mad
+             << "repetitions" << result.repetitions << "}";
+    }
+    file << "]";
+    return true;
+}
+
+inline bool read_results(const std::string &path, std::map<std::string, BenchResult> &results) {
+    cv::FileStorage file(path, cv::FileStorage::READ);
+    if (!file.isOpened()) return false;
+    cv::FileNode list = file["results"];
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        BenchResult result;
+        (*it)["name"] >> result.name;
+        (*it)["median_ms"] >> result.median;
+        (*it)["mad_ms"] >> result.mad;
+        (*it)["repetitions"] >> result.repetitions;
+        results[result.name] = result;
+    }
+    return true;
+}
+
+// A case regresses when it got slower by more than the tolerance and by more than the
+// combined noise of both runs, so jittery sub-millisecond cases do not raise alarms
+inline int compare_with_baseline(const std::vector<BenchResult> &results,
+                                 const std::map<std::string, BenchResult> &baseline, double tolerance) {
+    int regressions = 0;
+    for (const BenchResult &result: results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second.median <= 0) continue;
+        const BenchResult &base = it->second;
+        double ratio = result.median / base.median;
+        double noise = 3 * (result.mad + base.mad);
+        if (ratio > 1 + tolerance && result.median - base.median > noise) {
+            std::cout << "REGRESSION " << result.name << ": " << base.median << " ms -> " << result.median
+                      << " ms (x" << std::setprecision(2) << ratio << ")" << std::setprecision(3) << std::endl;
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+
+int main(int argc, char **argv) {
+    cv::utils::logging::setLogLevel(cv::utils::logging::LogLevel::LOG_LEVEL_ERROR);
+    BenchOptions options = parse_bench_options(argc, argv);
+
+    std::vector<int> thread_counts = {1};
+    if (cv::getNumberOfCPUs() > 1) thread_counts.push_back(cv::getNumberOfCPUs());
+
+    Bench bench(options);
+    run_filter_cases(bench, options, thread_counts);
+    run_fourier_cases(bench, options, thread_counts);
+    cv::setNumThreads(-1);
+
+    if (!options.json.empty() && !write_results(options.json, bench.results)) {
+        std::cerr << "Could not write " << options.json << std::endl;
+        return 2;
+    }
+
+    if (!options.baseline.empty()) {
+        std::map<std::string, BenchResult> baseline;
+        if (!read_results(options.baseline, baseline)) {
+            std::cerr << "Could not read " << options.baseline << std::endl;
+            return 2;
+        }
+        int regressions = compare_with_baseline(bench.results, baseline, options.tolerance);
+        std::cout << regressions << " regression(s) against " << options.baseline << std::endl;
+        return regressions ? 1 : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef CV_LESSONS_ANIMATION_H
+#define CV_LESSONS_ANIMATION_H
+
+#include <cmath>
+#include <vector>
+#include "opencv2/core.hpp"
+
+
+// An animation type provides a Params struct and a static position(params, args...).
+// Sprites sharing an animation type are kept in one AnimationGroup and evaluated together
+// in a plain loop the compiler can inline, instead of one std::function call per sprite.
+
+// Horizontal motion with time, vertical sine around center
+struct SineWave {
+    struct Params {
+        float center, amplitude, period, phase;
+    };
+
+    static cv::Point2f position(const Params &p, int time) {
+        return {(float)time, p.center + p.amplitude * std::sin((float)time / p.period + p.phase)};
+    }
+};
+
+
+template<class Animation>
+class AnimationGroup {
+    std::vector<typename Animation::Params> params;
+    std::vector<size_t> targets;
+    std::vector<cv::Point2f> positions;
+
+public:
+    void add(size_t sprite_index, const typename Animation::Params &sprite_params);
+
+    size_t size() const { return params.size(); }
+
+    template<class ... Args>
+    void evaluate(Args ... args);
+
+    // Moves every sprite of the group to its last evaluated position
+    template<class S>
+    void apply(std::vector<S> &sprites) const;
+};
+
+
+template<class Animation>
+void AnimationGroup<Animation>::add(size_t sprite_index, const typename Animation::Params &sprite_params) {
+    targets.push_back(sprite_index);
+    params.push_back(sprite_params);
+    positions.emplace_back();
+}
+
+template<class Animation>
+template<class ... Args>
+void AnimationGroup<Animation>::evaluate(Args ... args) {
+    const size_t n = params.size();
+    const typename Animation::Params *p = params.data();
+    cv::Point2f *out = positions.data();
+    for (size_t i = 0; i < n; i++) {
+        out[i] = Animation::position(p[i], args...);
+    }
+}
+
+template<class Animation>
+template<class S>
+void AnimationGroup<Animation>::apply(std::vector<S> &sprites) const {
+    for (size_t i = 0; i < targets.size(); i++) {
+        sprites[targets[i]].set_position(positions[i].x, positions[i].y);
+    }
+}
+
+#endif //CV_LESSONS_ANIMATION_H
@@ -4,11 +4,33 @@
 #include <opencv2/imgcodecs.hpp>
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
+#include <cstring>
 #include "sprite.h"
 
 template<class T>
 class App {
     friend T;
+
+    // Damage is tracked on a coarse grid of square cells; dirty cells are merged into
+    // horizontal spans that get the background restored and the sprites over them redrawn.
+    // Cells are grouped into tiles that are composited in parallel, each tile only writes
+    // inside its own rectangle and draws the sprites binned to it in insertion order.
+    static constexpr int CELL_SIZE = 32;
+    static constexpr int TILE_CELLS = 4;
+
+    cv::Mat frame;
+    std::vector<cv::Rect> drawn_rects;
+    std::vector<uint8_t> dirty_cells;
+    int grid_cols = 0, grid_rows = 0;
+    std::vector<std::vector<int>> tile_bins;
+    std::vector<uint8_t> dirty_tiles;
+    std::vector<int> tiles_to_draw;
+    int tile_cols = 0, tile_rows = 0;
+
+    void mark_dirty(cv::Rect area);
+
+    void compose_tile(int tile);
+
 protected:
     cv::Size canvas_size;
     cv::Mat background_img;
@@ -21,6 +43,19 @@ public:
 
     void add_sprite(T sprite);
 
+    size_t sprite_count() const { return sprites.size(); }
+
+    cv::Size size() const { return canvas_size; }
+
+    // Schedules a canvas region for redraw, needed after background_img is modified in place
+    void invalidate(cv::Rect area);
+
+    void invalidate();
+
+    // Advances animation or physics by one frame
+    virtual void update() {}
+
+    // The returned image is the compositor's own frame, it stays valid until the next call
     virtual cv::Mat render();
 };
 
@@ -30,6 +65,13 @@ App<T>::App(int width, int height, const char *background_path, const char *titl
  : canvas_size(width, height), title(title) {
     cv::Mat bg_img = cv::imread(background_path);
     cv::resize(bg_img, background_img, canvas_size);
+    grid_cols = (width + CELL_SIZE - 1) / CELL_SIZE;
+    grid_rows = (height + CELL_SIZE - 1) / CELL_SIZE;
+    dirty_cells.assign(grid_cols * grid_rows, 0);
+    tile_cols = (grid_cols + TILE_CELLS - 1) / TILE_CELLS;
+    tile_rows = (grid_rows + TILE_CELLS - 1) / TILE_CELLS;
+    tile_bins.resize(tile_cols * tile_rows);
+    dirty_tiles.assign(tile_cols * tile_rows, 0);
 }
 
 template<typename T>
@@ -37,15 +79,115 @@ void App<T>::add_sprite(T sprite) {
     sprites.push_back(sprite);
 }
 
+template<typename T>
+void App<T>::mark_dirty(cv::Rect area) {
+    area &= cv::Rect(0, 0, canvas_size.width, canvas_size.height);
+    if (area.empty()) return;
+    int col_end = (area.x + area.width - 1) / CELL_SIZE;
+    int row_end = (area.y + area.height - 1) / CELL_SIZE;
+    for (int row = area.y / CELL_SIZE; row <= row_end; row++) {
+        for (int col = area.x / CELL_SIZE; col <= col_end; col++) {
+            dirty_cells[row * grid_cols + col] = 1;
+        }
+    }
+}
+
+template<typename T>
+void App<T>::invalidate(cv::Rect area) {
+    mark_dirty(area);
+}
+
+template<typename T>
+void App<T>::invalidate() {
+    mark_dirty(cv::Rect(0, 0, canvas_size.width, canvas_size.height));
+}
+
+template<typename T>
+void App<T>::compose_tile(int tile) {
+    cv::Rect canvas(0, 0, canvas_size.width, canvas_size.height);
+    int col_begin = (tile % tile_cols) * TILE_CELLS;
+    int col_end = std::min(col_begin + TILE_CELLS, grid_cols);
+    int row_begin = (tile / tile_cols) * TILE_CELLS;
+    int row_end = std::min(row_begin + TILE_CELLS, grid_rows);
+
+    for (int row = row_begin; row < row_end; row++) {
+        for (int col = col_begin; col < col_end; col++) {
+            if (!dirty_cells[row * grid_cols + col]) continue;
+            int start = col;
+            while (col < col_end && dirty_cells[row * grid_cols + col]) {
+                dirty_cells[row * grid_cols + col] = 0;
+                col++;
+            }
+            cv::Rect span = cv::Rect(start * CELL_SIZE, row * CELL_SIZE,
+                                     (col - start) * CELL_SIZE, CELL_SIZE) & canvas;
+            for (int y = span.y; y < span.y + span.height; y++) {
+                std::memcpy(frame.ptr<uchar>(y) + 3 * span.x, background_img.ptr<uchar>(y) + 3 * span.x,
+                            3 * span.width);
+            }
+            for (int idx: tile_bins[tile]) {
+                cv::Rect clip = span & drawn_rects[idx];
+                if (!clip.empty()) {
+                    sprites[idx].draw_on(frame, clip);
+                }
+            }
+        }
+    }
+}
+
 template<typename T>
 cv::Mat App<T>::render() {
-    cv::Mat image = this->background_img.clone();
-    for (T sprite: this->sprites) {
-        if (sprite.fits_in(canvas_size)) {
-            sprite.draw_on(image);
+    if (frame.empty()) {
+        frame = background_img.clone();
+        invalidate();
+    }
+
+    cv::Rect canvas(0, 0, canvas_size.width, canvas_size.height);
+    drawn_rects.resize(sprites.size());
+    for (size_t i = 0; i < sprites.size(); i++) {
+        cv::Rect rect = sprites[i].fits_in(canvas_size) ? sprites[i].bounds() & canvas : cv::Rect();
+        if (rect != drawn_rects[i]) {
+            mark_dirty(drawn_rects[i]);
+            mark_dirty(rect);
+            drawn_rects[i] = rect;
         }
     }
-    return image;
+
+    std::fill(dirty_tiles.begin(), dirty_tiles.end(), 0);
+    for (int row = 0; row < grid_rows; row++) {
+        for (int col = 0; col < grid_cols; col++) {
+            if (dirty_cells[row * grid_cols + col]) {
+                dirty_tiles[(row / TILE_CELLS) * tile_cols + col / TILE_CELLS] = 1;
+            }
+        }
+    }
+
+    // Binning walks sprites in insertion order, so every bin keeps the z-order
+    const int tile_size = CELL_SIZE * TILE_CELLS;
+    for (auto &bin: tile_bins) bin.clear();
+    for (size_t i = 0; i < sprites.size(); i++) {
+        const cv::Rect &rect = drawn_rects[i];
+        if (rect.empty()) continue;
+        int col_end = (rect.x + rect.width - 1) / tile_size;
+        int row_end = (rect.y + rect.height - 1) / tile_size;
+        for (int row = rect.y / tile_size; row <= row_end; row++) {
+            for (int col = rect.x / tile_size; col <= col_end; col++) {
+                if (dirty_tiles[row * tile_cols + col]) {
+                    tile_bins[row * tile_cols + col].push_back((int)i);
+                }
+            }
+        }
+    }
+
+    tiles_to_draw.clear();
+    for (int tile = 0; tile < (int)dirty_tiles.size(); tile++) {
+        if (dirty_tiles[tile]) tiles_to_draw.push_back(tile);
+    }
+    cv::parallel_for_(cv::Range(0, (int)tiles_to_draw.size()), [&](const cv::Range &range) {
+        for (int k = range.start; k < range.end; k++) {
+            compose_tile(tiles_to_draw[k]);
+        }
+    });
+    return frame;
 }
 
 #endif //CV_LESSONS_APP_H
@@ -0,0 +1,169 @@
+#ifndef CV_LESSONS_BARNES_HUT_H
+#define CV_LESSONS_BARNES_HUT_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+
+// Quadtree over body positions, rebuilt every step. Nodes live in one flat vector,
+// the four children of a node are stored next to each other starting at first_child.
+class QuadTree {
+    struct Node {
+        float center_x, center_y, half_size;
+        float mass, mass_x, mass_y;
+        int first_child = -1;
+        int body = -1;
+        int count = 0;
+    };
+
+    std::vector<Node> nodes;
+    const float *xs = nullptr, *ys = nullptr, *masses = nullptr;
+
+    static constexpr int MAX_DEPTH = 32;
+
+    int quadrant(const Node &node, float x, float y) const {
+        return (x >= node.center_x ? 1 : 0) | (y >= node.center_y ? 2 : 0);
+    }
+
+    void subdivide(int node_idx);
+
+    void insert(int body);
+
+public:
+    float theta = 0.5;
+    float softening = 0;
+
+    void build(const float *x, const float *y, const float *mass, size_t count);
+
+    void acceleration(float x, float y, int self, float &ax, float &ay) const;
+
+    size_t node_count() const { return nodes.size(); }
+};
+
+
+inline void QuadTree::build(const float *x, const float *y, const float *mass, size_t count) {
+    xs = x;
+    ys = y;
+    masses = mass;
+    nodes.clear();
+    if (count == 0) return;
+
+    float min_x = x[0], max_x = x[0], min_y = y[0], max_y = y[0];
+    for (size_t i = 1; i < count; i++) {
+        min_x = std::min(min_x, x[i]);
+        max_x = std::max(max_x, x[i]);
+        min_y = std::min(min_y, y[i]);
+        max_y = std::max(max_y, y[i]);
+    }
+
+    Node root;
+    root.center_x = (min_x + max_x) / 2;
+    root.center_y = (min_y + max_y) / 2;
+    root.half_size = std::max(max_x - min_x, max_y - min_y) / 2 + 1;
+    root.mass = root.mass_x = root.mass_y = 0;
+    nodes.reserve(2 * count);
+    nodes.push_back(root);
+
+    for (int i = 0; i < (int)count; i++) {
+        insert(i);
+    }
+
+    // Weighted position sums become centers of mass once every body is in place
+    for (auto &node: nodes) {
+        if (node.mass > 0) {
+            node.mass_x /= node.mass;
+            node.mass_y /= node.mass;
+        } else {
+            node.mass_x = node.center_x;
+            node.mass_y = node.center_y;
+        }
+    }
+}
+
+inline void QuadTree::subdivide(int node_idx) {
+    int first = (int)nodes.size();
+    float quarter = nodes[node_idx].half_size / 2;
+    for (int q = 0; q < 4; q++) {
+        Node child;
+        child.center_x = nodes[node_idx].center_x + ((q & 1) ? quarter : -quarter);
+        child.center_y = nodes[node_idx].center_y + ((q & 2) ? quarter : -quarter);
+        child.half_size = quarter;
+        child.mass = child.mass_x = child.mass_y = 0;
+        nodes.push_back(child);
+    }
+    Node &node = nodes[node_idx];
+    node.first_child = first;
+
+    int old = node.body;
+    node.body = -1;
+    Node &child = nodes[first + quadrant(node, xs[old], ys[old])];
+    child.body = old;
+    child.count = 1;
+    child.mass = masses[old];
+    child.mass_x = masses[old] * xs[old];
+    child.mass_y = masses[old] * ys[old];
+}
+
+inline void QuadTree::insert(int body) {
+    float x = xs[body], y = ys[body], m = masses[body];
+    int node_idx = 0;
+    for (int depth = 0;; depth++) {
+        if (nodes[node_idx].first_child < 0) {
+            Node &leaf = nodes[node_idx];
+            if (leaf.count == 0 || depth == MAX_DEPTH) {
+                // Empty leaf takes the body; at max depth coincident bodies share one leaf
+                leaf.body = leaf.count == 0 ? body : -1;
+                leaf.count++;
+                leaf.mass += m;
+                leaf.mass_x += m * x;
+                leaf.mass_y += m * y;
+                return;
+            }
+            subdivide(node_idx);
+        }
+        Node &node = nodes[node_idx];
+        node.count++;
+        node.mass += m;
+        node.mass_x += m * x;
+        node.mass_y += m * y;
+        node_idx = node.first_child + quadrant(node, x, y);
+    }
+}
+
+inline void QuadTree::acceleration(float x, float y, int self, float &ax, float &ay) const {
+    ax = 0;
+    ay = 0;
+    if (nodes.empty()) return;
+
+    float theta_sq = theta * theta;
+    float eps_sq = softening * softening;
+    // Every opened node pushes four children and pops one, so the depth limit bounds the stack.
+    // Keeping it local makes the traversal safe to run from several threads over one tree.
+    int stack[3 * MAX_DEPTH + 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (node.count == 0 || node.body == self) continue;
+
+        float dx = node.mass_x - x;
+        float dy = node.mass_y - y;
+        float r_sq = dx * dx + dy * dy;
+        float size = 2 * node.half_size;
+        if (node.first_child < 0 || size * size < theta_sq * r_sq) {
+            r_sq += eps_sq;
+            if (r_sq == 0) continue;
+            float inv_r = 1 / std::sqrt(r_sq);
+            float s = node.mass * inv_r * inv_r * inv_r;
+            ax += s * dx;
+            ay += s * dy;
+        } else {
+            for (int q = 0; q < 4; q++) {
+                stack[top++] = node.first_child + q;
+            }
+        }
+    }
+}
+
+#endif //CV_LESSONS_BARNES_HUT_H
@@ -0,0 +1,83 @@
+#ifndef CV_LESSONS_BLIT_H
+#define CV_LESSONS_BLIT_H
+
+#include <algorithm>
+#include <cassert>
+#include "opencv2/core.hpp"
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+
+// dst * inverse_alpha / 255 rounded exactly, valid for all 8-bit inputs
+static inline int scale_by_inverse_alpha(int dst, int inverse_alpha) {
+    int t = dst * inverse_alpha + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+// Same rounding as scale_by_inverse_alpha on eight 16-bit lanes: for 16-bit t,
+// (t + (t >> 8)) >> 8 equals the high half of t * 257
+static inline __m128i scale_words(__m128i dst, __m128i inverse_alpha) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(dst, inverse_alpha), _mm_set1_epi16(128));
+    return _mm_mulhi_epu16(t, _mm_set1_epi16(257));
+}
+#endif
+
+// Premultiplied "over": dst = src + dst * (1 - src_alpha) on `count` bytes of BGR rows.
+// The texture keeps 255 - alpha repeated for each channel, so every byte of dst has its
+// own source and inverse alpha byte and no pixel shuffling is needed. SSE2 is part of
+// x86-64, so the 16 byte path is always built there; the 32 byte path needs AVX2
+// (CV_LESSONS_NATIVE). Bytes are never written past `count`.
+inline void blend_row(const uchar *src, const uchar *inverse_alpha, uchar *dst, int count) {
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i transparent32 = _mm256_set1_epi8((char)255);
+    for (; i + 32 <= count; i += 32) {
+        __m256i inv = _mm256_loadu_si256((const __m256i *)(inverse_alpha + i));
+        // Fully transparent source leaves dst unchanged
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(inv, transparent32)) == -1) continue;
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i zero = _mm256_setzero_si256();
+        __m256i t_lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+                                                           _mm256_unpacklo_epi8(inv, zero)), _mm256_set1_epi16(128));
+        __m256i t_hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+                                                           _mm256_unpackhi_epi8(inv, zero)), _mm256_set1_epi16(128));
+        t_lo = _mm256_mulhi_epu16(t_lo, _mm256_set1_epi16(257));
+        t_hi = _mm256_mulhi_epu16(t_hi, _mm256_set1_epi16(257));
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_adds_epu8(s, _mm256_packus_epi16(t_lo, t_hi)));
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    const __m128i transparent16 = _mm_set1_epi8((char)255);
+    for (; i + 16 <= count; i += 16) {
+        __m128i inv = _mm_loadu_si128((const __m128i *)(inverse_alpha + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(inv, transparent16)) == 0xffff) continue;
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i zero = _mm_setzero_si128();
+        __m128i lo = scale_words(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(inv, zero));
+        __m128i hi = scale_words(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(inv, zero));
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+#endif
+    for (; i < count; i++) {
+        if (inverse_alpha[i] == 255) continue;
+        dst[i] = (uchar)std::min(255, src[i] + scale_by_inverse_alpha(dst[i], inverse_alpha[i]));
+    }
+}
+
+// Composites src_roi of a premultiplied BGR texture with its per-channel inverse alpha
+// onto a BGR canvas at dst_origin. Works on row pointers directly, so no ROI headers
+// are created per draw.
+inline void blit_over(const cv::Mat &src, const cv::Mat &inverse_alpha, cv::Rect src_roi, cv::Mat &dst,
+                      cv::Point dst_origin) {
+    assert(src.type() == CV_8UC3 && inverse_alpha.type() == CV_8UC3 && dst.type() == CV_8UC3);
+    for (int y = 0; y < src_roi.height; y++) {
+        blend_row(src.ptr<uchar>(src_roi.y + y) + 3 * src_roi.x, inverse_alpha.ptr<uchar>(src_roi.y + y) + 3 * src_roi.x,
+                  dst.ptr<uchar>(dst_origin.y + y) + 3 * dst_origin.x, 3 * src_roi.width);
+    }
+}
+
+#endif //CV_LESSONS_BLIT_H
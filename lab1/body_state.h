@@ -0,0 +1,142 @@
+#ifndef CV_LESSONS_BODY_STATE_H
+#define CV_LESSONS_BODY_STATE_H
+
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+
+// Physics state of the N-body simulation kept as structure of arrays,
+// so the force loop reads only the floats it needs
+struct BodyState {
+    std::vector<float> x, y, vx, vy, mass, radius;
+    std::vector<int> id;  // index the body was added with, stable across merges
+
+    size_t size() const { return x.size(); }
+
+    void add(float mass, float pos_x, float pos_y, float vel_x, float vel_y, float body_radius = 0);
+
+    void resize(size_t count);
+
+    // Drops every body with removed[i] set, keeping the order of the rest
+    void compact(const std::vector<uint8_t> &removed);
+};
+
+inline void BodyState::add(float body_mass, float pos_x, float pos_y, float vel_x, float vel_y, float body_radius) {
+    id.push_back(id.empty() ? 0 : id.back() + 1);
+    x.push_back(pos_x);
+    y.push_back(pos_y);
+    vx.push_back(vel_x);
+    vy.push_back(vel_y);
+    mass.push_back(body_mass);
+    radius.push_back(body_radius);
+}
+
+inline void BodyState::resize(size_t count) {
+    x.resize(count);
+    y.resize(count);
+    vx.resize(count);
+    vy.resize(count);
+    mass.resize(count);
+    radius.resize(count);
+    id.resize(count);
+}
+
+inline void BodyState::compact(const std::vector<uint8_t> &removed) {
+    size_t kept = 0;
+    for (size_t i = 0; i < size(); i++) {
+        if (removed[i]) continue;
+        x[kept] = x[i];
+        y[kept] = y[i];
+        vx[kept] = vx[i];
+        vy[kept] = vy[i];
+        mass[kept] = mass[i];
+        radius[kept] = radius[i];
+        id[kept] = id[i];
+        kept++;
+    }
+    resize(kept);
+}
+
+
+// Softened all-pairs accelerations for bodies [begin, end) against every body.
+// The self term vanishes because dx = dy = 0, so the inner loop does not skip it.
+inline void compute_accelerations(const BodyState &state, float softening, float *ax, float *ay,
+                                  size_t begin, size_t end) {
+    const float *xs = state.x.data(), *ys = state.y.data(), *ms = state.mass.data();
+    const size_t n = state.size();
+    const float eps_sq = softening * softening;
+
+    for (size_t i = begin; i < end; i++) {
+        float xi = xs[i], yi = ys[i];
+        float sum_x = 0, sum_y = 0;
+        size_t j = 0;
+
+#if defined(__AVX2__)
+        const __m256 vxi = _mm256_set1_ps(xi), vyi = _mm256_set1_ps(yi), veps = _mm256_set1_ps(eps_sq);
+        const __m256 half = _mm256_set1_ps(0.5f), three_halves = _mm256_set1_ps(1.5f);
+        __m256 acc_x = _mm256_setzero_ps(), acc_y = _mm256_setzero_ps();
+        for (; j + 8 <= n; j += 8) {
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + j), vxi);
+            __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + j), vyi);
+            __m256 r_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), veps);
+            // rsqrt estimate refined by one Newton-Raphson step
+            __m256 inv_r = _mm256_rsqrt_ps(r_sq);
+            inv_r = _mm256_mul_ps(inv_r, _mm256_sub_ps(three_halves,
+                                  _mm256_mul_ps(_mm256_mul_ps(half, r_sq), _mm256_mul_ps(inv_r, inv_r))));
+            __m256 s = _mm256_mul_ps(_mm256_loadu_ps(ms + j), _mm256_mul_ps(inv_r, _mm256_mul_ps(inv_r, inv_r)));
+            // Zero softening leaves r_sq = 0 for the body itself, mask out its infinite term
+            s = _mm256_and_ps(s, _mm256_cmp_ps(r_sq, _mm256_setzero_ps(), _CMP_GT_OQ));
+            acc_x = _mm256_add_ps(acc_x, _mm256_mul_ps(s, dx));
+            acc_y = _mm256_add_ps(acc_y, _mm256_mul_ps(s, dy));
+        }
+        alignas(32) float lanes_x[8], lanes_y[8];
+        _mm256_store_ps(lanes_x, acc_x);
+        _mm256_store_ps(lanes_y, acc_y);
+        for (int k = 0; k < 8; k++) {
+            sum_x += lanes_x[k];
+            sum_y += lanes_y[k];
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        const __m128 vxi = _mm_set1_ps(xi), vyi = _mm_set1_ps(yi), veps = _mm_set1_ps(eps_sq);
+        const __m128 half = _mm_set1_ps(0.5f), three_halves = _mm_set1_ps(1.5f);
+        __m128 acc_x = _mm_setzero_ps(), acc_y = _mm_setzero_ps();
+        for (; j + 4 <= n; j += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + j), vxi);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + j), vyi);
+            __m128 r_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), veps);
+            __m128 inv_r = _mm_rsqrt_ps(r_sq);
+            inv_r = _mm_mul_ps(inv_r, _mm_sub_ps(three_halves,
+                               _mm_mul_ps(_mm_mul_ps(half, r_sq), _mm_mul_ps(inv_r, inv_r))));
+            __m128 s = _mm_mul_ps(_mm_loadu_ps(ms + j), _mm_mul_ps(inv_r, _mm_mul_ps(inv_r, inv_r)));
+            s = _mm_and_ps(s, _mm_cmpgt_ps(r_sq, _mm_setzero_ps()));
+            acc_x = _mm_add_ps(acc_x, _mm_mul_ps(s, dx));
+            acc_y = _mm_add_ps(acc_y, _mm_mul_ps(s, dy));
+        }
+        alignas(16) float lanes_x[4], lanes_y[4];
+        _mm_store_ps(lanes_x, acc_x);
+        _mm_store_ps(lanes_y, acc_y);
+        for (int k = 0; k < 4; k++) {
+            sum_x += lanes_x[k];
+            sum_y += lanes_y[k];
+        }
+#endif
+        for (; j < n; j++) {
+            float dx = xs[j] - xi;
+            float dy = ys[j] - yi;
+            float r_sq = dx * dx + dy * dy + eps_sq;
+            if (r_sq == 0) continue;
+            float inv_r = 1 / std::sqrt(r_sq);
+            float s = ms[j] * inv_r * inv_r * inv_r;
+            sum_x += s * dx;
+            sum_y += s * dy;
+        }
+        ax[i] = sum_x;
+        ay[i] = sum_y;
+    }
+}
+
+#endif //CV_LESSONS_BODY_STATE_H
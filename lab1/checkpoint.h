@@ -0,0 +1,318 @@
+#ifndef CV_LESSONS_CHECKPOINT_H
+#define CV_LESSONS_CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "body_state.h"
+
+
+// Checkpoint file: CheckpointHeader followed by the x, y, vx, vy, mass, radius and id
+// columns of BodyState, each `count` elements long, exactly as they sit in memory.
+// Trajectory file: TrajectoryHeader followed by frames of TrajectoryFrame + x, y, id columns.
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t step;
+};
+
+struct TrajectoryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct TrajectoryFrame {
+    uint64_t step;
+    uint64_t count;
+};
+
+constexpr char CHECKPOINT_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'C', 'K', 'P'};
+constexpr char TRAJECTORY_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'T', 'R', 'J'};
+constexpr uint32_t STATE_FORMAT_VERSION = 1;
+// Ids keep the index a body was added with, so after merges they exceed the body count;
+// load_checkpoint rejects files with ids at or above this limit
+constexpr int CHECKPOINT_MAX_ID = 1 << 20;
+
+
+template<class V>
+void write_column(std::ofstream &file, const V &column) {
+    file.write((const char *)column.data(), (std::streamsize)(column.size() * sizeof(column[0])));
+}
+
+inline bool save_checkpoint(const std::string &path, const BodyState &state, uint64_t step) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    CheckpointHeader header{};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = STATE_FORMAT_VERSION;
+    header.count = state.size();
+    header.step = step;
+    file.write((const char *)&header, sizeof(header));
+    write_column(file, state.x);
+    write_column(file, state.y);
+    write_column(file, state.vx);
+    write_column(file, state.vy);
+    write_column(file, state.mass);
+    write_column(file, state.radius);
+    write_column(file, state.id);
+    return (bool)file;
+}
+
+
+// Read-only view of a whole file mapped into memory
+class MappedFile {
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+
+public:
+    explicit MappedFile(const std::string &path);
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    const uint8_t *data() const { return data_; }
+
+    size_t size() const { return size_; }
+};
+
+#ifdef _WIN32
+inline MappedFile::MappedFile(const std::string &path) {
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return;
+    data_ = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data_) size_ = (size_t)file_size.QuadPart;
+}
+
+inline MappedFile::~MappedFile() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+#else
+inline MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data_ = (const uint8_t *)mapped;
+            size_ = (size_t)st.st_size;
+        }
+    }
+    close(fd);
+}
+
+inline MappedFile::~MappedFile() {
+    if (data_) munmap((void *)data_, size_);
+}
+#endif
+
+
+template<class T>
+const uint8_t *read_column(const uint8_t *src, std::vector<T> &column, size_t count) {
+    column.resize(count);
+    std::memcpy(column.data(), src, count * sizeof(T));
+    return src + count * sizeof(T);
+}
+
+inline bool load_checkpoint(const std::string &path, BodyState &state, uint64_t &step) {
+    MappedFile file(path);
+    if (file.size() < sizeof(CheckpointHeader)) return false;
+    CheckpointHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != STATE_FORMAT_VERSION) return false;
+    // count comes from the file, so it is bounded before it is multiplied
+    const size_t body_size = 6 * sizeof(float) + sizeof(int);
+    if (header.count > (file.size() - sizeof(header)) / body_size) return false;
+    // Ids index the bodies' sprites, so they must be unique and below CHECKPOINT_MAX_ID;
+    // checked before state is touched
+    const uint8_t *src = file.data() + sizeof(header);
+    std::vector<uint8_t> seen;
+    for (size_t i = 0; i < header.count; i++) {
+        int id;
+        std::memcpy(&id, src + 6 * header.count * sizeof(float) + i * sizeof(int), sizeof(id));
+        if (id < 0 || id >= CHECKPOINT_MAX_ID) return false;
+        if ((size_t)id >= seen.size()) seen.resize((size_t)id + 1, 0);
+        if (seen[id]) return false;
+        seen[id] = 1;
+    }
+
+    src = read_column(src, state.x, header.count);
+    src = read_column(src, state.y, header.count);
+    src = read_column(src, state.vx, header.count);
+    src = read_column(src, state.vy, header.count);
+    src = read_column(src, state.mass, header.count);
+    src = read_column(src, state.radius, header.count);
+    read_column(src, state.id, header.count);
+    step = header.step;
+    return true;
+}
+
+
+// Writes trajectory frames and checkpoints on a background thread. Callers only copy the
+// state columns into a recycled buffer; if the disk falls more than max_pending jobs
+// behind, the caller waits for it.
+class StateWriter {
+    struct Job {
+        BodyState state;
+        uint64_t step = 0;
+        std::string checkpoint_path;  // empty for trajectory frames
+    };
+
+    std::ofstream trajectory;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable job_ready, job_done;
+    std::deque<Job> jobs;
+    std::vector<Job> spare;
+    bool closing = false;
+
+    Job take_spare();
+
+    void submit(Job job);
+
+    void write_frame(const Job &job);
+
+    void run();
+
+public:
+    size_t max_pending = 4;
+
+    ~StateWriter() { close(); }
+
+    bool open_trajectory(const std::string &path);
+
+    void push_frame(const BodyState &state, uint64_t step);
+
+    void push_checkpoint(const std::string &path, const BodyState &state, uint64_t step);
+
+    void close();
+};
+
+
+inline bool StateWriter::open_trajectory(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    trajectory.open(path, std::ios::binary | std::ios::trunc);
+    if (!trajectory) return false;
+    TrajectoryHeader header{};
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = STATE_FORMAT_VERSION;
+    trajectory.write((const char *)&header, sizeof(header));
+    return true;
+}
+
+inline StateWriter::Job StateWriter::take_spare() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (spare.empty()) return {};
+    Job job = std::move(spare.back());
+    spare.pop_back();
+    return job;
+}
+
+inline void StateWriter::submit(Job job) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!worker.joinable()) {
+        closing = false;
+        worker = std::thread(&StateWriter::run, this);
+    }
+    job_done.wait(lock, [&] { return jobs.size() < max_pending; });
+    jobs.push_back(std::move(job));
+    job_ready.notify_one();
+}
+
+inline void StateWriter::push_frame(const BodyState &state, uint64_t step) {
+    Job job = take_spare();
+    job.step = step;
+    job.checkpoint_path.clear();
+    job.state.x.assign(state.x.begin(), state.x.end());
+    job.state.y.assign(state.y.begin(), state.y.end());
+    job.state.id.assign(state.id.begin(), state.id.end());
+    submit(std::move(job));
+}
+
+inline void StateWriter::push_checkpoint(const std::string &path, const BodyState &state, uint64_t step) {
+    Job job = take_spare();
+    job.step = step;
+    job.checkpoint_path = path;
+    job.state = state;
+    submit(std::move(job));
+}
+
+inline void StateWriter::write_frame(const Job &job) {
+    if (!trajectory.is_open()) return;
+    TrajectoryFrame frame{job.step, job.state.x.size()};
+    trajectory.write((const char *)&frame, sizeof(frame));
+    write_column(trajectory, job.state.x);
+    write_column(trajectory, job.state.y);
+    write_column(trajectory, job.state.id);
+}
+
+inline void StateWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        job_ready.wait(lock, [&] { return closing || !jobs.empty(); });
+        if (jobs.empty()) break;
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+
+        if (job.checkpoint_path.empty()) {
+            write_frame(job);
+        } else if (!save_checkpoint(job.checkpoint_path, job.state, job.step)) {
+            std::cerr << "Could not write checkpoint " << job.checkpoint_path << std::endl;
+        }
+
+        lock.lock();
+        spare.push_back(std::move(job));
+        job_done.notify_all();
+    }
+}
+
+inline void StateWriter::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+        job_ready.notify_one();
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    trajectory.close();
+}
+
+#endif //CV_LESSONS_CHECKPOINT_H
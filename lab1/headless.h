@@ -0,0 +1,115 @@
+#ifndef CV_LESSONS_HEADLESS_H
+#define CV_LESSONS_HEADLESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+#include "app.h"
+
+
+struct HeadlessOptions {
+    bool enabled = false;
+    int frames = 600;
+    int count = 0;       // size of the synthetic scene, 0 keeps the demo scene
+    uint64_t seed = 1;
+    std::string output;  // *.raw gets raw BGR frames, anything else goes to cv::VideoWriter
+};
+
+// Recognizes --headless [frames], --count N, --seed S and --output PATH
+inline HeadlessOptions parse_headless_options(int argc, char **argv) {
+    HeadlessOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc && argv[i + 1][0] != '-';
+        if (arg == "--headless") {
+            options.enabled = true;
+            if (has_value) options.frames = std::stoi(argv[++i]);
+        } else if (arg == "--count" && has_value) {
+            options.count = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (arg == "--output" && has_value) {
+            options.output = argv[++i];
+        }
+    }
+    return options;
+}
+
+struct TimingStats {
+    double mean = 0, p50 = 0, p99 = 0;  // milliseconds
+};
+
+inline TimingStats summarize(std::vector<double> samples) {
+    TimingStats stats;
+    if (samples.empty()) return stats;
+    std::sort(samples.begin(), samples.end());
+    for (double sample: samples) stats.mean += sample;
+    stats.mean /= (double)samples.size();
+    stats.p50 = samples[(samples.size() - 1) / 2];
+    stats.p99 = samples[(size_t)((double)(samples.size() - 1) * 0.99)];
+    return stats;
+}
+
+inline std::ostream &operator<<(std::ostream &os, const TimingStats &stats) {
+    return os << "mean " << stats.mean << " ms, p50 " << stats.p50 << " ms, p99 " << stats.p99 << " ms";
+}
+
+// Steps the app a fixed number of frames without a window, optionally recording them,
+// and prints per-frame update/render timings and the overall frame rate
+template<class T>
+void run_headless(App<T> &app, const HeadlessOptions &options) {
+    using clock = std::chrono::steady_clock;
+    using ms = std::chrono::duration<double, std::milli>;
+
+    cv::VideoWriter video;
+    std::ofstream raw;
+    bool is_raw = options.output.size() > 4 && options.output.substr(options.output.size() - 4) == ".raw";
+    if (!options.output.empty()) {
+        if (is_raw) {
+            raw.open(options.output, std::ios::binary);
+        } else {
+            video.open(options.output, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, app.size());
+        }
+        if (!raw.is_open() && !video.isOpened()) {
+            std::cerr << "Could not open " << options.output << " for writing" << std::endl;
+        }
+    }
+
+    std::vector<double> update_times, render_times;
+    update_times.reserve(options.frames);
+    render_times.reserve(options.frames);
+
+    auto start = clock::now();
+    for (int frame_idx = 0; frame_idx < options.frames; frame_idx++) {
+        auto frame_start = clock::now();
+        app.update();
+        auto updated = clock::now();
+        cv::Mat frame = app.render();
+        auto rendered = clock::now();
+        update_times.push_back(ms(updated - frame_start).count());
+        render_times.push_back(ms(rendered - updated).count());
+
+        if (raw.is_open()) {
+            for (int y = 0; y < frame.rows; y++) {
+                raw.write((const char *)frame.ptr<uchar>(y), (std::streamsize)(frame.cols * frame.elemSize()));
+            }
+        } else if (video.isOpened()) {
+            video.write(frame);
+        }
+    }
+    double total = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::cout << app.title << ": " << options.frames << " frames, " << app.sprite_count() << " sprites, "
+              << app.size().width << "x" << app.size().height << std::endl;
+    std::cout << "update: " << summarize(update_times) << std::endl;
+    std::cout << "render: " << summarize(render_times) << std::endl;
+    std::cout << "fps: " << options.frames / total << std::endl;
+}
+
+#endif //CV_LESSONS_HEADLESS_H
@@ -1,74 +1,177 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include "opencv2/core.hpp"
 #include "opencv2/highgui.hpp"
 
 #include "app.h"
 #include "sprite.h"
+#include "simulation.h"
+#include "headless.h"
 
 
 const float G_CONST = 5;
+const char *BODY_TEXTURE = "../lab1/images/planet.png";
 
-class Body : public Sprite<double> {
-public:
-    float mass, vx, vy;
-
-    Body(const char* name, const char* texture_path, float mass, int pos_x, int pos_y, float vx, float vy)
-    : mass(mass), Sprite<double>(name, texture_path), vx(vx), vy(vy) {
-        set_position((float)pos_x, (float)pos_y);
-    }
-};
+// Bodies are drawn as plain sprites, their physics lives in NBodyApp::simulation
+using Body = Sprite<double>;
 
 class NBodyApp : public App<Body> {
+    static constexpr float HIDDEN_POSITION = -1e6;
+    std::vector<uint8_t> alive;
+    size_t shown_count = 0;
+
 public:
+    Simulation simulation;
+
     NBodyApp(int width, int height, const char *background_path, const char *title)
-    : App<Body>(width, height, background_path, title) {}
-
-    cv::Mat render() override {
-        float dt = 0.5;
-        for (auto& body : sprites) {
-            float ax = 0.0;
-            float ay = 0.0;
-
-            for (const auto& other_body: sprites) {
-                if (&other_body == &body) continue;
-                float dx = other_body.x_center - body.x_center;
-                float dy = other_body.y_center - body.y_center;
-                float r = std::sqrt(dx * dx + dy * dy);
-                float r_accel = (float)other_body.mass / (r * r);
-                ax += r_accel * dx / r;
-                ay += r_accel * dy / r;
+    : App<Body>(width, height, background_path, title) {
+        simulation.gravity = G_CONST;
+    }
+
+    void add_body(Body body, float mass, int pos_x, int pos_y, float vx, float vy) {
+        body.set_position((float)pos_x, (float)pos_y);
+        float radius = (float)std::min(body.bounds().width, body.bounds().height) / 2;
+        simulation.add_body(mass, (float)pos_x, (float)pos_y, vx, vy, radius);
+        add_sprite(body);
+    }
+
+    // Replaces the scene with the checkpoint's bodies. It may have been saved from a scene
+    // of another size, so the sprites are rebuilt with one for every id it can hold;
+    // load_checkpoint keeps the ids below CHECKPOINT_MAX_ID.
+    bool restore_checkpoint(const std::string &path) {
+        if (!simulation.restore_checkpoint(path)) return false;
+        const Snapshot &snapshot = simulation.latest();
+        size_t id_count = 0;
+        for (int id: snapshot.id) id_count = std::max(id_count, (size_t)id + 1);
+        sprites.clear();
+        for (size_t i = 0; i < id_count; i++) {
+            add_sprite(Body("body", BODY_TEXTURE));
+        }
+        invalidate();
+        shown_count = SIZE_MAX;
+        return true;
+    }
+
+    // Takes the latest published positions; without a running simulation thread
+    // it advances one step itself, which keeps headless runs deterministic
+    void update() override {
+        if (!simulation.is_running()) {
+            simulation.advance();
+        }
+        const Snapshot &snapshot = simulation.latest();
+        if (snapshot.id.size() != shown_count) {
+            // Bodies absorbed in a merge are parked off the canvas, where the compositor culls them
+            alive.assign(sprites.size(), 0);
+            for (int id: snapshot.id) {
+                if (id >= 0 && (size_t)id < alive.size()) alive[id] = 1;
             }
-            body.vx += ax * G_CONST * dt;
-            body.vy += ay * G_CONST * dt;
+            for (size_t i = 0; i < sprites.size(); i++) {
+                if (!alive[i]) sprites[i].set_position(HIDDEN_POSITION, HIDDEN_POSITION);
+            }
+            shown_count = snapshot.id.size();
         }
-        for (auto& body: sprites) {
-            body.set_position(body.x_center + body.vx * dt,
-                              body.y_center + body.vy * dt);
+        for (size_t i = 0; i < snapshot.x.size(); i++) {
+            int id = snapshot.id[i];
+            if (id >= 0 && (size_t)id < sprites.size()) sprites[id].set_position(snapshot.x[i], snapshot.y[i]);
         }
-        return App::render();
     }
 };
 
 
-int main() {
-    // Body sun("sun", "../lab1_2/sun.png", 100, 500, 500, 0, 0);
-    Body planet1("planet1", "../lab1/images/planet.png", 5000, 100, 500, 0.5, 0);
-    Body planet2("planet2", "../lab1/images/planet.png", 75, 100, 700, 12, 0);
-    Body planet3("planet3", "../lab1/images/planet.png", 50, 100, 300, 10, 0);
-    Body planet4("planet4", "../lab1/images/planet.png", 100, 400, 500, 0, 10);
+const char *USAGE = "Usage: lab1_2 [--headless [frames]] [--count N] [--seed S] [--output PATH] "
+                    "[--barnes-hut] [--restore CHECKPOINT] [--trajectory PATH [N]]";
+
+// Whole decimal number above zero, anything else leaves value untouched
+bool parse_positive(const char *text, int &value) {
+    char *end = nullptr;
+    errno = 0;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed <= 0 || parsed > INT_MAX) return false;
+    value = (int)parsed;
+    return true;
+}
 
+// Light bodies on circular orbits around a heavy one in the middle of the canvas
+void add_synthetic_bodies(NBodyApp &app, int count, uint64_t seed) {
+    cv::RNG rng(seed);
+    float center_x = (float)app.size().width / 2, center_y = (float)app.size().height / 2;
+    float central_mass = 5000;
+    app.add_body(Body("sun", BODY_TEXTURE), central_mass, (int)center_x, (int)center_y, 0, 0);
+    for (int i = 1; i < count; i++) {
+        float radius = rng.uniform(50.f, center_y);
+        float angle = rng.uniform(0.f, 6.2832f);
+        float speed = std::sqrt(G_CONST * central_mass / radius);
+        app.add_body(Body("body", BODY_TEXTURE), rng.uniform(0.1f, 10.f),
+                     int(center_x + radius * cos(angle)), int(center_y + radius * sin(angle)),
+                     -speed * sin(angle), speed * cos(angle));
+    }
+}
+
+
+int main(int argc, char **argv) {
+    HeadlessOptions options = parse_headless_options(argc, argv);
     NBodyApp app(1920, 1080, "../lab1/images/background2.png", "test");
 
-    app.add_sprite(planet1);
-    app.add_sprite(planet2);
-    app.add_sprite(planet3);
-    app.add_sprite(planet4);
+    if (options.count > 0) {
+        add_synthetic_bodies(app, options.count, options.seed);
+    } else {
+        // Body sun("sun", "../lab1_2/sun.png", 100, 500, 500, 0, 0);
+        Body planet1("planet1", "../lab1/images/planet.png");
+        Body planet2("planet2", "../lab1/images/planet.png");
+        Body planet3("planet3", "../lab1/images/planet.png");
+        Body planet4("planet4", "../lab1/images/planet.png");
+
+        app.add_body(planet1, 5000, 100, 500, 0.5, 0);
+        app.add_body(planet2, 75, 100, 700, 12, 0);
+        app.add_body(planet3, 50, 100, 300, 10, 0);
+        app.add_body(planet4, 100, 400, 500, 0, 10);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--barnes-hut") {
+            app.simulation.force_mode = ForceMode::BarnesHut;
+        } else if (arg == "--restore" && i + 1 < argc) {
+            if (!app.restore_checkpoint(argv[++i])) {
+                std::cerr << "Could not restore checkpoint " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--trajectory" && i + 1 < argc) {
+            int every = 10;
+            if (i + 2 < argc && argv[i + 2][0] != '-' && !parse_positive(argv[i + 2], every)) {
+                std::cerr << "--trajectory needs a positive step count, got " << argv[i + 2] << std::endl
+                          << USAGE << std::endl;
+                return -1;
+            }
+            if (!app.simulation.record_trajectory(argv[++i], every)) {
+                std::cerr << "Could not open trajectory " << argv[i] << std::endl;
+                return -1;
+            }
+            if (i + 1 < argc && argv[i + 1][0] != '-') i++;
+        }
+    }
+
+    if (options.enabled) {
+        run_headless(app, options);
+        return 0;
+    }
+    app.simulation.start();
 
     while (true) {
+        app.update();
         cv::imshow(app.title, app.render());
         int c = cv::waitKey(10);
         if (c == 27) {
             break;
         }
+        if (c == 'c') {
+            app.simulation.request_checkpoint("nbody.ckpt");
+        }
+        if (c == 'm') {
+            auto& mode = app.simulation.force_mode;
+            mode = mode == ForceMode::AllPairs ? ForceMode::BarnesHut : ForceMode::AllPairs;
+        }
     }
 
     return 0;
@@ -4,44 +4,79 @@
 
 #include "sprite.h"
 #include "app.h"
+#include "headless.h"
+#include "animation.h"
 
 static int x_position = 0;
 
 class SimpleSpriteApp : public App<Sprite<int>> {
+    AnimationGroup<SineWave> sine_paths;
+
 public:
     int speed = 1;
 
     SimpleSpriteApp(int width, int height, const char *background_path, const char *title)
     : App<Sprite<int>>(width, height, background_path, title) {}
 
-    cv::Mat render() override {
+    void add_sprite(Sprite<int> sprite, SineWave::Params path) {
+        sine_paths.add(sprites.size(), path);
+        App::add_sprite(sprite);
+    }
+
+    void update() override {
         x_position += speed;
         if ((speed > 0 && x_position > background_img.cols) || (speed < 0 && x_position < 1)) {
             speed *= -1;
         }
+        sine_paths.evaluate(x_position);
+        sine_paths.apply(sprites);
         for (Sprite<int> &sprite: sprites) {
-            sprite.animate(x_position);
-            cv::circle(background_img, cv::Point((int)sprite.x_center, (int)sprite.y_center),
-                       1,cv::Scalar(0, 0, 255), 1);
+            cv::Point center((int)sprite.x_center, (int)sprite.y_center);
+            cv::circle(background_img, center, 1,cv::Scalar(0, 0, 255), 1);
+            invalidate(cv::Rect(center.x - 2, center.y - 2, 5, 5));
         }
-
-        return App::render();
     }
 };
 
 
-int main() {
+// Robots on sine paths with random height, amplitude and phase, for scaling measurements
+void add_synthetic_robots(SimpleSpriteApp &app, int count, uint64_t seed) {
+    cv::RNG rng(seed);
+    int height = app.size().height;
+    for (int i = 0; i < count; i++) {
+        SineWave::Params path;
+        path.center = rng.uniform(0.f, (float)height);
+        path.amplitude = rng.uniform(10.f, (float)height / 2);
+        path.period = rng.uniform(30.f, 200.f);
+        path.phase = rng.uniform(0.f, 6.2832f);
+        app.add_sprite(Sprite<int>("robot", "../lab1/images/robot.png"), path);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    HeadlessOptions options = parse_headless_options(argc, argv);
     SimpleSpriteApp app(640, 480, "../lab1/images/background1.jpg", "test_project");
 
     Sprite<int> robot1("robot1", "../lab1/images/robot.png");
     Sprite<int> robot2("robot2", "../lab1/images/robot.png");
-    robot1.set_animation([](int time){return cv::Point2i(time, int(240 + 350 * sin((float)time / 100)));});
-    robot2.set_animation([](int time){return cv::Point2i (time, int(200 + 150 * cos((float)time / 100)));});
+    SineWave::Params path1 = {240, 350, 100, 0};
+    SineWave::Params path2 = {200, 150, 100, (float)CV_PI / 2};  // cosine
 
-    app.add_sprite(robot1);
-    app.add_sprite(robot2);
+    if (options.count > 0) {
+        add_synthetic_robots(app, options.count, options.seed);
+    } else {
+        app.add_sprite(robot1, path1);
+        app.add_sprite(robot2, path2);
+    }
+
+    if (options.enabled) {
+        run_headless(app, options);
+        return 0;
+    }
 
     while (true) {
+        app.update();
         auto image = app.render();
         cv::imshow(app.title, image);
 
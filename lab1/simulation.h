@@ -0,0 +1,279 @@
+#ifndef CV_LESSONS_SIMULATION_H
+#define CV_LESSONS_SIMULATION_H
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "opencv2/core.hpp"
+
+#include "barnes_hut.h"
+#include "body_state.h"
+#include "spatial_hash.h"
+#include "checkpoint.h"
+#include "triple_buffer.h"
+
+
+enum class ForceMode { AllPairs, BarnesHut };
+
+struct Snapshot {
+    std::vector<float> x, y;
+    std::vector<int> id;
+    uint64_t step = 0;
+};
+
+// Fixed-timestep N-body integrator running on its own thread. Every step is a
+// kick-drift-kick leapfrog, the force pass is split across cores with cv::parallel_for_
+// and the positions are published through a triple buffer the renderer reads lock-free.
+class Simulation {
+    BodyState state;
+    std::vector<float> ax, ay;
+    QuadTree tree;
+    SpatialHash grid;
+    std::vector<uint8_t> merged;
+    std::vector<std::pair<int, int>> overlaps;
+    StateWriter writer;
+    int trajectory_every = 0;
+    std::mutex checkpoint_mutex;
+    std::string checkpoint_path;
+    std::atomic<bool> checkpoint_requested{false};
+    TripleBuffer<Snapshot> snapshots;
+    std::thread worker;
+    std::atomic<bool> running{false};
+    uint64_t step_count = 0;
+
+    void compute_forces();
+
+    void resolve_collisions();
+
+    void write_state();
+
+    void run();
+
+public:
+    std::atomic<ForceMode> force_mode{ForceMode::AllPairs};
+    float gravity = 5;
+    float dt = 0.5;
+    float softening = 1;
+    float theta = 0.5;
+    // Overlapping bodies merge into one, conserving mass and momentum
+    bool collisions = true;
+    // Physics steps per wall-clock second, 0 runs the simulation as fast as it can
+    double steps_per_second = 100;
+
+    ~Simulation() { stop(); }
+
+    void add_body(float mass, float pos_x, float pos_y, float vel_x, float vel_y, float radius = 0);
+
+    size_t size() const { return state.size(); }
+
+    void step();
+
+    void publish();
+
+    // One step followed by a publish, for driving the simulation without its thread
+    void advance() { step(); publish(); }
+
+    void start();
+
+    void stop();
+
+    bool is_running() const { return running; }
+
+    // Appends positions of every k-th step to a trajectory file on a background thread,
+    // false if the file cannot be opened or every is not positive
+    bool record_trajectory(const std::string &path, int every);
+
+    // Thread-safe, the state is copied at the next step boundary and written in the background
+    void request_checkpoint(const std::string &path);
+
+    // Only while the simulation thread is stopped
+    bool restore_checkpoint(const std::string &path);
+
+    const Snapshot &latest();
+};
+
+
+inline void Simulation::add_body(float mass, float pos_x, float pos_y, float vel_x, float vel_y, float radius) {
+    assert(!running);
+    state.add(mass, pos_x, pos_y, vel_x, vel_y, radius);
+}
+
+inline void Simulation::compute_forces() {
+    size_t n = state.size();
+    ax.resize(n);
+    ay.resize(n);
+    if (force_mode == ForceMode::BarnesHut) {
+        tree.theta = theta;
+        tree.softening = softening;
+        tree.build(state.x.data(), state.y.data(), state.mass.data(), n);
+        cv::parallel_for_(cv::Range(0, (int)n), [&](const cv::Range &range) {
+            for (int i = range.start; i < range.end; i++) {
+                tree.acceleration(state.x[i], state.y[i], i, ax[i], ay[i]);
+            }
+        });
+    } else {
+        cv::parallel_for_(cv::Range(0, (int)n), [&](const cv::Range &range) {
+            compute_accelerations(state, softening, ax.data(), ay.data(), range.start, range.end);
+        });
+    }
+}
+
+inline void Simulation::step() {
+    size_t n = state.size();
+    if (ax.size() != n) {
+        compute_forces();
+    }
+    float half_kick = gravity * dt / 2;
+    for (size_t i = 0; i < n; i++) {
+        state.vx[i] += ax[i] * half_kick;
+        state.vy[i] += ay[i] * half_kick;
+        state.x[i] += state.vx[i] * dt;
+        state.y[i] += state.vy[i] * dt;
+    }
+    compute_forces();
+    for (size_t i = 0; i < n; i++) {
+        state.vx[i] += ax[i] * half_kick;
+        state.vy[i] += ay[i] * half_kick;
+    }
+    if (collisions) {
+        resolve_collisions();
+    }
+    step_count++;
+    write_state();
+}
+
+inline void Simulation::write_state() {
+    if (trajectory_every > 0 && step_count % trajectory_every == 0) {
+        writer.push_frame(state, step_count);
+    }
+    if (checkpoint_requested.exchange(false)) {
+        std::lock_guard<std::mutex> lock(checkpoint_mutex);
+        writer.push_checkpoint(checkpoint_path, state, step_count);
+    }
+}
+
+inline bool Simulation::record_trajectory(const std::string &path, int every) {
+    assert(!running);
+    if (every <= 0 || !writer.open_trajectory(path)) return false;
+    trajectory_every = every;
+    return true;
+}
+
+inline void Simulation::request_checkpoint(const std::string &path) {
+    std::lock_guard<std::mutex> lock(checkpoint_mutex);
+    checkpoint_path = path;
+    checkpoint_requested = true;
+}
+
+inline bool Simulation::restore_checkpoint(const std::string &path) {
+    assert(!running);
+    if (!load_checkpoint(path, state, step_count)) return false;
+    ax.clear();
+    ay.clear();
+    grid = SpatialHash();
+    publish();
+    return true;
+}
+
+// Overlaps are collected against the grid first and merged after the walk, so every test
+// sees the positions and radii the grid was built from. A merged body grows and moves,
+// which can make new overlaps, so the search repeats until a pass finds none.
+inline void Simulation::resolve_collisions() {
+    while (true) {
+        size_t n = state.size();
+        float max_radius = 0;
+        for (float r: state.radius) max_radius = std::max(max_radius, r);
+        if (n < 2 || max_radius <= 0) return;
+
+        // Cells only need rebuilding when the body list or the largest diameter changed
+        if (grid.size() != n || grid.get_cell_size() < 2 * max_radius) {
+            grid.rebuild(state.x.data(), state.y.data(), n, 2 * max_radius);
+        } else {
+            grid.update(state.x.data(), state.y.data());
+        }
+
+        overlaps.clear();
+        grid.for_each_overlap(state.x.data(), state.y.data(), state.radius.data(), [&](int i, int j) {
+            overlaps.emplace_back(i, j);
+        });
+        if (overlaps.empty()) return;
+
+        // Absorbed bodies drop out of later pairs, the first pair always merges
+        merged.assign(n, 0);
+        for (auto [i, j]: overlaps) {
+            if (merged[i] || merged[j]) continue;
+            // The heavier body keeps its id, so its sprite stays on screen
+            if (state.mass[j] > state.mass[i]) {
+                state.id[i] = state.id[j];
+            }
+            float m = state.mass[i] + state.mass[j];
+            float wi = m > 0 ? state.mass[i] / m : 0.5f, wj = 1 - wi;
+            state.x[i] = wi * state.x[i] + wj * state.x[j];
+            state.y[i] = wi * state.y[i] + wj * state.y[j];
+            state.vx[i] = wi * state.vx[i] + wj * state.vx[j];
+            state.vy[i] = wi * state.vy[i] + wj * state.vy[j];
+            state.radius[i] = std::sqrt(state.radius[i] * state.radius[i] + state.radius[j] * state.radius[j]);
+            state.mass[i] = m;
+            merged[j] = 1;
+        }
+
+        state.compact(merged);
+        // Accelerations belong to the old body list, the next step recomputes them
+        ax.clear();
+        ay.clear();
+    }
+}
+
+inline void Simulation::publish() {
+    Snapshot &snapshot = snapshots.write_buffer();
+    snapshot.x.assign(state.x.begin(), state.x.end());
+    snapshot.y.assign(state.y.begin(), state.y.end());
+    snapshot.id.assign(state.id.begin(), state.id.end());
+    snapshot.step = step_count;
+    snapshots.publish();
+}
+
+inline void Simulation::run() {
+    using clock = std::chrono::steady_clock;
+    auto next_step = clock::now();
+    while (running) {
+        step();
+        publish();
+        if (steps_per_second > 0) {
+            next_step += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1 / steps_per_second));
+            auto now = clock::now();
+            if (next_step > now) {
+                std::this_thread::sleep_until(next_step);
+            } else if (now - next_step > std::chrono::milliseconds(100)) {
+                // Too far behind to catch up, drop the backlog instead of spiralling
+                next_step = now;
+            }
+        }
+    }
+}
+
+inline void Simulation::start() {
+    if (running) return;
+    publish();
+    running = true;
+    worker = std::thread(&Simulation::run, this);
+}
+
+inline void Simulation::stop() {
+    running = false;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+inline const Snapshot &Simulation::latest() {
+    snapshots.update();
+    return snapshots.read_buffer();
+}
+
+#endif //CV_LESSONS_SIMULATION_H
@@ -0,0 +1,94 @@
+#ifndef CV_LESSONS_SPATIAL_HASH_H
+#define CV_LESSONS_SPATIAL_HASH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+// Uniform grid over the plane with hashed cells. With cells at least as large as the
+// biggest body diameter every overlapping pair sits in the same or a neighbouring cell.
+// Between rebuilds only bodies that crossed a cell border are moved.
+class SpatialHash {
+    float cell_size = 0;
+    std::unordered_map<int64_t, std::vector<int>> cells;
+    std::vector<int64_t> body_cells;
+
+    static int64_t key(int64_t cx, int64_t cy) { return (cx << 32) ^ (cy & 0xffffffff); }
+
+    int64_t cell_of(float x, float y) const {
+        return key((int64_t)std::floor(x / cell_size), (int64_t)std::floor(y / cell_size));
+    }
+
+    void remove(int body, int64_t cell);
+
+public:
+    void rebuild(const float *x, const float *y, size_t count, float new_cell_size);
+
+    void update(const float *x, const float *y);
+
+    float get_cell_size() const { return cell_size; }
+
+    size_t size() const { return body_cells.size(); }
+
+    // Calls func(i, j) once for every pair with i < j whose circles overlap
+    template<class F>
+    void for_each_overlap(const float *x, const float *y, const float *radius, F func) const;
+};
+
+
+inline void SpatialHash::rebuild(const float *x, const float *y, size_t count, float new_cell_size) {
+    cell_size = new_cell_size;
+    cells.clear();
+    body_cells.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        body_cells[i] = cell_of(x[i], y[i]);
+        cells[body_cells[i]].push_back((int)i);
+    }
+}
+
+inline void SpatialHash::remove(int body, int64_t cell) {
+    auto &bodies = cells[cell];
+    auto it = std::find(bodies.begin(), bodies.end(), body);
+    *it = bodies.back();
+    bodies.pop_back();
+    if (bodies.empty()) {
+        cells.erase(cell);
+    }
+}
+
+inline void SpatialHash::update(const float *x, const float *y) {
+    for (size_t i = 0; i < body_cells.size(); i++) {
+        int64_t cell = cell_of(x[i], y[i]);
+        if (cell != body_cells[i]) {
+            remove((int)i, body_cells[i]);
+            cells[cell].push_back((int)i);
+            body_cells[i] = cell;
+        }
+    }
+}
+
+template<class F>
+void SpatialHash::for_each_overlap(const float *x, const float *y, const float *radius, F func) const {
+    for (size_t i = 0; i < body_cells.size(); i++) {
+        int64_t cx = (int64_t)std::floor(x[i] / cell_size);
+        int64_t cy = (int64_t)std::floor(y[i] / cell_size);
+        for (int64_t dy = -1; dy <= 1; dy++) {
+            for (int64_t dx = -1; dx <= 1; dx++) {
+                auto it = cells.find(key(cx + dx, cy + dy));
+                if (it == cells.end()) continue;
+                for (int j: it->second) {
+                    if (j <= (int)i) continue;
+                    float ddx = x[j] - x[i], ddy = y[j] - y[i], r = radius[i] + radius[j];
+                    if (ddx * ddx + ddy * ddy < r * r) {
+                        func((int)i, j);
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif //CV_LESSONS_SPATIAL_HASH_H
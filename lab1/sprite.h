@@ -5,14 +5,15 @@
 #include <algorithm>
 #include "opencv2/core.hpp"
 #include <opencv2/imgproc.hpp>
+#include "texture_cache.h"
+#include "blit.h"
 
 
 template<class ... Args>
 class Sprite {
 protected:
     std::function<cv::Point2i(Args ...)> animation_func;
-    cv::Mat texture;
-    cv::Mat alpha_mask;
+    std::shared_ptr<const Texture> texture;
     int x_pos, y_pos;
 
 public:
@@ -26,20 +27,20 @@ public:
 
     bool fits_in(cv::Size canvas_size);
 
+    cv::Rect bounds() const { return {x_pos, y_pos, texture->cols(), texture->rows()}; }
+
     void set_position(float pos_x, float pos_y);
 
     void draw_on(cv::Mat background);
 
+    void draw_on(cv::Mat &background, cv::Rect clip) const;
+
     void animate(Args ...);
 };
 
 template<typename ... Args>
 Sprite<Args...>::Sprite(const char *name, const char *texture_path)
-: name(name), x_center(0), y_center(0) {
-    cv::Mat image = cv::imread(texture_path, cv::IMREAD_UNCHANGED);
-    cv::cvtColor(image, texture, cv::COLOR_BGRA2BGR);
-    cv::extractChannel(image, alpha_mask, 3);
-}
+: texture(load_texture(texture_path)), x_pos(0), y_pos(0), name(name), x_center(0), y_center(0) {}
 
 template<typename ... Args>
 void Sprite<Args...>::set_animation(std::function<cv::Point2i(Args...)> func) {
@@ -48,25 +49,29 @@ void Sprite<Args...>::set_animation(std::function<cv::Point2i(Args...)> func) {
 
 template<typename ... Args>
 bool Sprite<Args...>::fits_in(cv::Size canvas_size) {
-    auto intersect = cv::Rect(0, 0, canvas_size.width, canvas_size.height) &
-            cv::Rect(x_pos, y_pos, texture.cols, texture.rows);
+    auto intersect = cv::Rect(0, 0, canvas_size.width, canvas_size.height) & bounds();
     return (bool)intersect.area();
 }
 
 template<typename ... Args>
 void Sprite<Args...>::draw_on(cv::Mat background) {
-    cv::Rect bg_roi(x_pos, y_pos, texture.cols, texture.rows);
-    bg_roi &= cv::Rect(0, 0, background.cols, background.rows);
-    cv::Rect texture_roi = cv::Rect(std::max(0, -x_pos), std::max(0, -y_pos), bg_roi.width, bg_roi.height);
-    cv::copyTo(texture(texture_roi), background(bg_roi), alpha_mask(texture_roi));
+    draw_on(background, cv::Rect(0, 0, background.cols, background.rows));
+}
+
+template<typename ... Args>
+void Sprite<Args...>::draw_on(cv::Mat &background, cv::Rect clip) const {
+    cv::Rect bg_roi = bounds() & clip & cv::Rect(0, 0, background.cols, background.rows);
+    if (bg_roi.empty()) return;
+    cv::Rect texture_roi = cv::Rect(bg_roi.x - x_pos, bg_roi.y - y_pos, bg_roi.width, bg_roi.height);
+    blit_over(texture->premultiplied, texture->inverse_alpha, texture_roi, background, bg_roi.tl());
 }
 
 template<typename ... Args>
 void Sprite<Args ...>::set_position(float pos_x, float pos_y) {
     x_center = pos_x;
     y_center = pos_y;
-    x_pos = (int)x_center - texture.cols / 2;
-    y_pos = (int)y_center - texture.rows / 2;
+    x_pos = (int)x_center - texture->cols() / 2;
+    y_pos = (int)y_center - texture->rows() / 2;
 }
 
 template<typename ... Args>
@@ -0,0 +1,61 @@
+#ifndef CV_LESSONS_TEXTURE_CACHE_H
+#define CV_LESSONS_TEXTURE_CACHE_H
+
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "opencv2/core.hpp"
+#include <opencv2/imgcodecs.hpp>
+
+
+// Decoded sprite texture, shared read-only between every sprite that uses the same file.
+// Both planes have the canvas layout, so blending works on matching bytes.
+struct Texture {
+    cv::Mat premultiplied;  // BGR already multiplied by alpha / 255
+    cv::Mat inverse_alpha;  // 255 - alpha repeated for each channel
+
+    int cols() const { return premultiplied.cols; }
+    int rows() const { return premultiplied.rows; }
+};
+
+inline std::shared_ptr<const Texture> decode_texture(const std::string &path) {
+    auto texture = std::make_shared<Texture>();
+    cv::Mat bgra = cv::imread(path, cv::IMREAD_UNCHANGED);
+    assert(!bgra.empty() && bgra.channels() == 4);
+
+    texture->premultiplied.create(bgra.size(), CV_8UC3);
+    texture->inverse_alpha.create(bgra.size(), CV_8UC3);
+    for (int y = 0; y < bgra.rows; y++) {
+        const uchar *src = bgra.ptr<uchar>(y);
+        uchar *color = texture->premultiplied.ptr<uchar>(y);
+        uchar *inverse = texture->inverse_alpha.ptr<uchar>(y);
+        for (int x = 0; x < bgra.cols; x++) {
+            int a = src[4 * x + 3];
+            for (int c = 0; c < 3; c++) {
+                color[3 * x + c] = (uchar)((src[4 * x + c] * a + 127) / 255);
+                inverse[3 * x + c] = (uchar)(255 - a);
+            }
+        }
+    }
+    return texture;
+}
+
+// Process-wide cache keyed by path. Entries are held weakly, so a texture is decoded
+// once while any sprite uses it and released together with the last of them.
+inline std::shared_ptr<const Texture> load_texture(const std::string &path) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<const Texture>> cache;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &entry = cache[path];
+    auto texture = entry.lock();
+    if (!texture) {
+        texture = decode_texture(path);
+        entry = texture;
+    }
+    return texture;
+}
+
+#endif //CV_LESSONS_TEXTURE_CACHE_H
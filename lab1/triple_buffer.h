@@ -0,0 +1,42 @@
+#ifndef CV_LESSONS_TRIPLE_BUFFER_H
+#define CV_LESSONS_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+
+// Single producer / single consumer hand-off without locks. The producer fills the back
+// buffer and swaps it with the shared middle one, the consumer swaps its front buffer with
+// the middle one only when something new was published. Neither side ever waits.
+template<class T>
+class TripleBuffer {
+    static constexpr int FRESH = 4;
+
+    T buffers[3];
+    std::atomic<int> middle{1};
+    int back = 0;
+    int front = 2;
+
+public:
+    T &write_buffer() { return buffers[back]; }
+
+    void publish();
+
+    bool update();
+
+    const T &read_buffer() const { return buffers[front]; }
+};
+
+
+template<class T>
+void TripleBuffer<T>::publish() {
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+template<class T>
+bool TripleBuffer<T>::update() {
+    if (!(middle.load(std::memory_order_acquire) & FRESH)) return false;
+    front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+    return true;
+}
+
+#endif //CV_LESSONS_TRIPLE_BUFFER_H
@@ -0,0 +1,176 @@
+#ifndef CV_LESSONS_BOX_FILTER_H
+#define CV_LESSONS_BOX_FILTER_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "opencv2/core.hpp"
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+
+// Box filter built from running sums: every row is summed with a sliding window, then the
+// row sums are accumulated down the columns, adding the entering row and subtracting the
+// leaving one. The cost per pixel does not depend on the box size.
+// Borders are reflected like BORDER_REFLECT_101, the default of filter2D and cv::blur.
+
+template<class T>
+void box_row_sums(const T *src, int width, int radius, std::vector<uint32_t> &padded, uint32_t *dst) {
+    int box_size = 2 * radius + 1;
+    padded.resize(width + 2 * radius);
+    // Only the 2 * radius border pixels need borderInterpolate, the rest is a plain copy
+    for (int x = 0; x < radius; x++) {
+        padded[x] = src[cv::borderInterpolate(x - radius, width, cv::BORDER_REFLECT_101)];
+        padded[width + radius + x] = src[cv::borderInterpolate(width + x, width, cv::BORDER_REFLECT_101)];
+    }
+    std::copy(src, src + width, padded.begin() + radius);
+    uint32_t sum = 0;
+    for (int x = 0; x < box_size; x++) {
+        sum += padded[x];
+    }
+    dst[0] = sum;
+    for (int x = 1; x < width; x++) {
+        sum += padded[x + box_size - 1] - padded[x - 1];
+        dst[x] = sum;
+    }
+}
+
+// For 8-bit images a box sum is below 255^3 < 2^24, so the sum, the quotient times the area
+// and their difference are exact in float. S * (1 / area) + 0.5 rounds every possible sum
+// correctly up to BOX_FLOAT_EXACT_SIZE (checked exhaustively); for larger boxes it can be
+// off by one, and one correction with the exact remainder r makes it round(S / area).
+// area is odd, so r is never exactly area / 2.
+constexpr int BOX_FLOAT_EXACT_SIZE = 163;
+
+#if defined(__AVX2__)
+inline __m256i box_divide_8(__m256i sums, __m256 scale, __m256 area, bool correct) {
+    __m256 s = _mm256_cvtepi32_ps(sums);
+    __m256i q = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(s, scale), _mm256_set1_ps(0.5f)));
+    if (!correct) return q;
+    __m256 r2 = _mm256_mul_ps(_mm256_set1_ps(2.f), _mm256_sub_ps(s, _mm256_mul_ps(_mm256_cvtepi32_ps(q), area)));
+    // The compare masks are -1 where true
+    q = _mm256_sub_epi32(q, _mm256_castps_si256(_mm256_cmp_ps(r2, area, _CMP_GT_OQ)));
+    return _mm256_add_epi32(q, _mm256_castps_si256(_mm256_cmp_ps(r2, _mm256_sub_ps(_mm256_setzero_ps(), area),
+                                                                 _CMP_LT_OQ)));
+}
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+inline __m128i box_divide_4(__m128i sums, __m128 scale, __m128 area, bool correct) {
+    __m128 s = _mm_cvtepi32_ps(sums);
+    __m128i q = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(s, scale), _mm_set1_ps(0.5f)));
+    if (!correct) return q;
+    __m128 r2 = _mm_mul_ps(_mm_set1_ps(2.f), _mm_sub_ps(s, _mm_mul_ps(_mm_cvtepi32_ps(q), area)));
+    q = _mm_sub_epi32(q, _mm_castps_si128(_mm_cmpgt_ps(r2, area)));
+    return _mm_add_epi32(q, _mm_castps_si128(_mm_cmplt_ps(r2, _mm_sub_ps(_mm_setzero_ps(), area))));
+}
+#endif
+
+// column_sums += entering - leaving, then dst = round(column_sums / area)
+template<class T>
+void box_accumulate_row(uint32_t *column_sums, const uint32_t *entering, const uint32_t *leaving,
+                        T *dst, int width, int area) {
+    int x = 0;
+    if constexpr (sizeof(T) == 1) {
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+        const bool correct = area > BOX_FLOAT_EXACT_SIZE * BOX_FLOAT_EXACT_SIZE;
+#endif
+#if defined(__AVX2__)
+        const __m256 vscale = _mm256_set1_ps(1.f / (float)area), varea = _mm256_set1_ps((float)area);
+        for (; x + 8 <= width; x += 8) {
+            __m256i sums = _mm256_loadu_si256((const __m256i *)(column_sums + x));
+            __m256i values = box_divide_8(sums, vscale, varea, correct);
+            // Pack eight 32-bit results down to bytes, all of them fit in 0..255
+            __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+            _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(words, words));
+            if (entering) {
+                sums = _mm256_add_epi32(sums, _mm256_loadu_si256((const __m256i *)(entering + x)));
+                sums = _mm256_sub_epi32(sums, _mm256_loadu_si256((const __m256i *)(leaving + x)));
+                _mm256_storeu_si256((__m256i *)(column_sums + x), sums);
+            }
+        }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+        // SSE2 is part of x86-64, so this path runs without CV_LESSONS_NATIVE
+        const __m128 scale4 = _mm_set1_ps(1.f / (float)area), area4 = _mm_set1_ps((float)area);
+        for (; x + 8 <= width; x += 8) {
+            __m128i sums_lo = _mm_loadu_si128((const __m128i *)(column_sums + x));
+            __m128i sums_hi = _mm_loadu_si128((const __m128i *)(column_sums + x + 4));
+            __m128i lo = box_divide_4(sums_lo, scale4, area4, correct);
+            __m128i hi = box_divide_4(sums_hi, scale4, area4, correct);
+            // SSE2 only packs 32-bit lanes with signed saturation, enough for 0..255
+            __m128i words = _mm_packs_epi32(lo, hi);
+            _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(words, words));
+            if (entering) {
+                sums_lo = _mm_add_epi32(sums_lo, _mm_loadu_si128((const __m128i *)(entering + x)));
+                sums_hi = _mm_add_epi32(sums_hi, _mm_loadu_si128((const __m128i *)(entering + x + 4)));
+                sums_lo = _mm_sub_epi32(sums_lo, _mm_loadu_si128((const __m128i *)(leaving + x)));
+                sums_hi = _mm_sub_epi32(sums_hi, _mm_loadu_si128((const __m128i *)(leaving + x + 4)));
+                _mm_storeu_si128((__m128i *)(column_sums + x), sums_lo);
+                _mm_storeu_si128((__m128i *)(column_sums + x + 4), sums_hi);
+            }
+        }
+#endif
+        for (; x < width; x++) {
+            dst[x] = (T)((column_sums[x] + (uint32_t)area / 2) / (uint32_t)area);
+            if (entering) column_sums[x] += entering[x] - leaving[x];
+        }
+    } else {
+        double scale = 1. / area;
+        for (; x < width; x++) {
+            dst[x] = (T)(uint32_t)((double)column_sums[x] * scale + 0.5);
+            if (entering) column_sums[x] += entering[x] - leaving[x];
+        }
+    }
+}
+
+template<class T>
+void box_filter_running_sum(const cv::Mat &src, cv::Mat &dst, int radius) {
+    int width = src.cols, height = src.rows, box_size = 2 * radius + 1;
+    dst.create(src.size(), src.type());
+
+    // Row sums of the last box_size virtual rows, virtual row v lives in slot (v + radius) % box_size
+    std::vector<uint32_t> ring((size_t)box_size * width), column_sums(width, 0), padded;
+    auto slot = [&](int v) { return ring.data() + (size_t)((v + radius) % box_size) * width; };
+    auto sum_row = [&](int v) {
+        const T *row = src.ptr<T>(cv::borderInterpolate(v, height, cv::BORDER_REFLECT_101));
+        box_row_sums(row, width, radius, padded, slot(v));
+    };
+
+    for (int v = -radius; v <= radius; v++) {
+        sum_row(v);
+        const uint32_t *sums = slot(v);
+        for (int x = 0; x < width; x++) column_sums[x] += sums[x];
+    }
+
+    std::vector<uint32_t> entering(width);
+    for (int y = 0; y < height; y++) {
+        if (y + 1 < height) {
+            // Row y + radius + 1 enters and reuses the slot of row y - radius, which leaves
+            int v = y + radius + 1;
+            const T *row = src.ptr<T>(cv::borderInterpolate(v, height, cv::BORDER_REFLECT_101));
+            box_row_sums(row, width, radius, padded, entering.data());
+            box_accumulate_row(column_sums.data(), entering.data(), slot(y - radius), dst.ptr<T>(y), width,
+                               box_size * box_size);
+            std::copy(entering.begin(), entering.end(), slot(v));
+        } else {
+            box_accumulate_row<T>(column_sums.data(), nullptr, nullptr, dst.ptr<T>(y), width, box_size * box_size);
+        }
+    }
+}
+
+// Drop-in for the filter2D based box_filter on CV_8UC1 and CV_16UC1 images
+inline cv::Mat box_filter_fast(const cv::Mat &img, int box_size = 3) {
+    assert(!img.empty() && img.channels() == 1 && box_size % 2 != 0 && box_size >= 3 && box_size <= 255);
+    assert(img.depth() == CV_8U || img.depth() == CV_16U);
+    cv::Mat result;
+    if (img.depth() == CV_8U) {
+        box_filter_running_sum<uint8_t>(img, result, box_size / 2);
+    } else {
+        box_filter_running_sum<uint16_t>(img, result, box_size / 2);
+    }
+    return result;
+}
+
+#endif //CV_LESSONS_BOX_FILTER_H
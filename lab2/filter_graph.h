@@ -0,0 +1,384 @@
+#ifndef CV_LESSONS_FILTER_GRAPH_H
+#define CV_LESSONS_FILTER_GRAPH_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include "filters.h"
+
+
+// Lazy pipelines of lab2 image operations on CV_8UC1 images of one size. Building a node
+// only records it; identical nodes are merged on creation, so asking twice for the box
+// blur of the same input yields one node that is computed once.
+//
+// evaluate() computes everything row by row. A node gets a full-size buffer only when it
+// has to: it is an input, a result, read by a stencil (which needs neighbouring rows),
+// read by log_amplify (which needs the global range first) or read by several nodes.
+// Every other node is fused into its single consumer: its row is produced into a small
+// scratch row right before the consumer needs it, so e.g. absdiff(box(a), b) never
+// stores the blurred image. Scratch rows are thread_local, kept across evaluations and
+// shared by every graph evaluated on that thread; they only hold a row while it is being
+// computed, so graphs taking turns on a thread do not disturb each other.
+// Intermediate buffers come from a pool kept by the graph and go back to it as soon as
+// their last reader is done; results are written into the caller's output Mats, reused
+// like cv::Mat::create does. Re-running a pipeline into the same outputs does not allocate.
+//
+// Intermediate results are 8-bit like the Mats of the eager functions; box and Laplace
+// use the fixed-point kernels, Gaussian the float separable one. Every op reads CV_8UC1
+// rows, so the CV_8S result of log_amplify can only be a final result.
+
+enum class GraphOp {Input, Box, Gaussian, Laplace, AbsDiff, Unsharp, LogAmplify};
+
+class FilterGraph {
+public:
+    using Node = int;
+
+private:
+    struct GraphNode {
+        GraphOp op;
+        Node inputs[2] = {-1, -1};
+        int ksize = 0;
+        int param = 0;              // Unsharp: alpha in Q8, Gaussian: sigma in thousandths
+        cv::Mat image;              // Input only
+        std::vector<float> kernel;  // Gaussian only
+    };
+
+    using Key = std::tuple<GraphOp, Node, Node, int, int, const uchar *>;
+
+    // Per-evaluation state of a node
+    struct Plan {
+        int consumers = 0;
+        bool materialize = false;
+        bool result = false;
+        int last_use = -1;       // index of the last materialized node reading this buffer
+        int result_output = -1;  // index in outputs of a result's buffer
+        cv::Mat buffer;
+        std::vector<uchar> table;  // LogAmplify lookup table
+    };
+
+    // Scratch rows of fused nodes and kernel buffers, one per thread for all graphs
+    struct Scratch {
+        std::vector<std::vector<uchar>> rows;
+        std::vector<uint16_t> padded, sums;
+        std::vector<float> float_padded, blur;
+    };
+
+    std::vector<GraphNode> nodes;
+    std::map<Key, Node> known;
+    std::vector<cv::Mat> pool;
+    std::vector<Plan> plans;
+    cv::Size size;
+
+    Node add(GraphNode node);
+
+    // Asserts that node exists and produces CV_8UC1, i.e. is not a log_amplify
+    void check_source(Node node) const;
+
+    cv::Mat acquire(int type);
+
+    void release(cv::Mat &buffer);
+
+    void collect(Node node, std::vector<Node> &order, std::vector<bool> &visited);
+
+    void mark_reads(Node node, int step);
+
+    const uchar *row(Node node, int y, Scratch &scratch);
+
+    void compute_row(Node node, int y, uchar *dst, Scratch &scratch);
+
+    void build_log_table(Node node);
+
+public:
+    Node input(const cv::Mat &image);
+
+    Node box(Node src, int ksize);
+
+    Node gaussian(Node src, int ksize, double sigma = 0);
+
+    Node laplace(Node src, int ksize);
+
+    Node absdiff(Node first, Node second);
+
+    // saturate(src + alpha * (src - blurred)) with alpha in Q8 like unsharp_mask_fixed
+    Node unsharp(Node src, Node blurred, double alpha);
+
+    Node unsharp_box(Node src, int ksize, double alpha) { return unsharp(src, box(src, ksize), alpha); }
+
+    Node unsharp_gaussian(Node src, int ksize, double alpha) { return unsharp(src, gaussian(src, ksize), alpha); }
+
+    // Same output as log_amplify: CV_8S, log(1 + v) stretched to the full range
+    Node log_amplify(Node src);
+
+    // Computes several results in one go, nodes they share are computed once. outputs[i]
+    // receives results[i]; its buffer is reused when it already has the right size and
+    // type and is not shared with an input or an earlier output.
+    void evaluate(const std::vector<Node> &results, std::vector<cv::Mat> &outputs);
+
+    std::vector<cv::Mat> evaluate(const std::vector<Node> &results) {
+        std::vector<cv::Mat> outputs;
+        evaluate(results, outputs);
+        return outputs;
+    }
+
+    cv::Mat evaluate(Node result) { return evaluate(std::vector<Node>{result})[0]; }
+};
+
+
+inline FilterGraph::Node FilterGraph::add(GraphNode node) {
+    Key key{node.op, node.inputs[0], node.inputs[1], node.ksize, node.param,
+            node.op == GraphOp::Input ? node.image.data : nullptr};
+    auto it = known.find(key);
+    if (it != known.end()) return it->second;
+    nodes.push_back(std::move(node));
+    known[key] = (Node)nodes.size() - 1;
+    return (Node)nodes.size() - 1;
+}
+
+inline void FilterGraph::check_source(Node node) const {
+    assert(node >= 0 && node < (Node)nodes.size() && nodes[node].op != GraphOp::LogAmplify);
+}
+
+inline FilterGraph::Node FilterGraph::input(const cv::Mat &image) {
+    assert(image.type() == CV_8UC1 && (nodes.empty() || image.size() == size));
+    size = image.size();
+    GraphNode node{GraphOp::Input};
+    node.image = image;
+    return add(std::move(node));
+}
+
+inline FilterGraph::Node FilterGraph::box(Node src, int ksize) {
+    assert(ksize % 2 == 1 && ksize >= 3 && ksize <= FIXED_MAX_KSIZE);
+    check_source(src);
+    GraphNode node{GraphOp::Box, {src, -1}, ksize};
+    return add(std::move(node));
+}
+
+inline FilterGraph::Node FilterGraph::gaussian(Node src, int ksize, double sigma) {
+    assert(ksize % 2 == 1 && ksize >= 3);
+    check_source(src);
+    GraphNode node{GraphOp::Gaussian, {src, -1}, ksize, (int)std::lround(sigma * 1000)};
+    node.kernel = gaussian_kernel_1d(ksize, sigma);
+    return add(std::move(node));
+}
+
+inline FilterGraph::Node FilterGraph::laplace(Node src, int ksize) {
+    assert(ksize % 2 == 1 && ksize >= 3 && ksize <= FIXED_MAX_KSIZE);
+    check_source(src);
+    GraphNode node{GraphOp::Laplace, {src, -1}, ksize};
+    return add(std::move(node));
+}
+
+inline FilterGraph::Node FilterGraph::absdiff(Node first, Node second) {
+    check_source(first);
+    check_source(second);
+    // |a - b| is symmetric, ordering the inputs lets both spellings share a node
+    GraphNode node{GraphOp::AbsDiff, {std::min(first, second), std::max(first, second)}};
+    return add(std::move(node));
+}
+
+inline FilterGraph::Node FilterGraph::unsharp(Node src, Node blurred, double alpha) {
+    check_source(src);
+    check_source(blurred);
+    GraphNode node{GraphOp::Unsharp, {src, blurred}, 0, fixed_alpha(alpha)};
+    return add(std::move(node));
+}
+
+inline FilterGraph::Node FilterGraph::log_amplify(Node src) {
+    check_source(src);
+    GraphNode node{GraphOp::LogAmplify, {src, -1}};
+    return add(std::move(node));
+}
+
+
+inline cv::Mat FilterGraph::acquire(int type) {
+    for (size_t i = 0; i < pool.size(); i++) {
+        if (pool[i].size() == size && pool[i].type() == type) {
+            cv::Mat buffer = pool[i];
+            pool.erase(pool.begin() + (long)i);
+            return buffer;
+        }
+    }
+    return cv::Mat(size, type);
+}
+
+inline void FilterGraph::release(cv::Mat &buffer) {
+    if (!buffer.empty()) pool.push_back(buffer);
+    buffer.release();
+}
+
+// Post-order walk, so every node comes after its inputs
+inline void FilterGraph::collect(Node node, std::vector<Node> &order, std::vector<bool> &visited) {
+    if (visited[node]) return;
+    visited[node] = true;
+    for (Node in: nodes[node].inputs) {
+        if (in < 0) continue;
+        collect(in, order, visited);
+        plans[in].consumers++;
+    }
+    order.push_back(node);
+}
+
+// Records that materializing the node at `step` reads the buffers reached through node
+inline void FilterGraph::mark_reads(Node node, int step) {
+    for (Node in: nodes[node].inputs) {
+        if (in < 0) continue;
+        if (plans[in].materialize) {
+            plans[in].last_use = std::max(plans[in].last_use, step);
+        } else {
+            mark_reads(in, step);
+        }
+    }
+}
+
+inline const uchar *FilterGraph::row(Node node, int y, Scratch &scratch) {
+    if (plans[node].materialize) return plans[node].buffer.ptr<uchar>(y);
+    std::vector<uchar> &dst = scratch.rows[node];
+    dst.resize(size.width);
+    compute_row(node, y, dst.data(), scratch);
+    return dst.data();
+}
+
+inline void FilterGraph::compute_row(Node node, int y, uchar *dst, Scratch &scratch) {
+    const GraphNode &n = nodes[node];
+    const int width = size.width;
+    switch (n.op) {
+        case GraphOp::Input:
+            std::copy(n.image.ptr<uchar>(y), n.image.ptr<uchar>(y) + width, dst);
+            break;
+        case GraphOp::Box:
+        case GraphOp::Laplace:
+            fixed_filter_row(plans[n.inputs[0]].buffer, y, n.op == GraphOp::Box ? FixedFilter::Box : FixedFilter::Laplace,
+                             n.ksize, 0, scratch.padded, scratch.sums, dst);
+            break;
+        case GraphOp::Gaussian: {
+            scratch.blur.resize(width);
+            separable_blur_row(plans[n.inputs[0]].buffer, y, n.kernel, scratch.float_padded, scratch.blur.data());
+            const float *blur = scratch.blur.data();
+            for (int x = 0; x < width; x++) {
+                dst[x] = (uchar)std::clamp((int)(blur[x] + 0.5f), 0, 255);
+            }
+            break;
+        }
+        case GraphOp::AbsDiff: {
+            const uchar *a = row(n.inputs[0], y, scratch), *b = row(n.inputs[1], y, scratch);
+            for (int x = 0; x < width; x++) {
+                dst[x] = (uchar)std::abs(a[x] - b[x]);
+            }
+            break;
+        }
+        case GraphOp::Unsharp: {
+            const uchar *src = row(n.inputs[0], y, scratch), *blurred = row(n.inputs[1], y, scratch);
+            const int alpha_q = n.param;
+            for (int x = 0; x < width; x++) {
+                dst[x] = (uchar)std::clamp(src[x] + ((alpha_q * (src[x] - blurred[x]) + 128) >> 8), 0, 255);
+            }
+            break;
+        }
+        case GraphOp::LogAmplify: {
+            const uchar *src = row(n.inputs[0], y, scratch), *table = plans[node].table.data();
+            for (int x = 0; x < width; x++) {
+                dst[x] = table[src[x]];
+            }
+            break;
+        }
+    }
+}
+
+inline void FilterGraph::build_log_table(Node node) {
+    cv::Mat table = log_amplify_table(plans[nodes[node].inputs[0]].buffer);
+    plans[node].table.assign(table.ptr<uchar>(), table.ptr<uchar>() + 256);
+}
+
+inline void FilterGraph::evaluate(const std::vector<Node> &results, std::vector<cv::Mat> &outputs) {
+    plans.assign(nodes.size(), Plan());
+    std::vector<Node> order;
+    std::vector<bool> visited(nodes.size(), false);
+    for (Node result: results) {
+        collect(result, order, visited);
+        plans[result].result = true;
+    }
+
+    for (Node node: order) {
+        const GraphNode &n = nodes[node];
+        bool needs_rows = n.op == GraphOp::Box || n.op == GraphOp::Gaussian || n.op == GraphOp::Laplace ||
+                          n.op == GraphOp::LogAmplify;
+        if (needs_rows) plans[n.inputs[0]].materialize = true;
+        if (n.op == GraphOp::Input || plans[node].consumers > 1 || plans[node].result) {
+            plans[node].materialize = true;
+        }
+    }
+
+    std::vector<Node> steps;
+    for (Node node: order) {
+        if (!plans[node].materialize) continue;
+        mark_reads(node, (int)steps.size());
+        steps.push_back(node);
+    }
+
+    // A result is computed straight into its output. Outputs that share memory with an
+    // input or with an earlier output, e.g. after a previous call, are detached first.
+    outputs.resize(results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        Node result = results[i];
+        if (nodes[result].op == GraphOp::Input || plans[result].result_output >= 0) continue;
+        bool shared = false;
+        for (const GraphNode &n: nodes) {
+            shared |= n.op == GraphOp::Input && outputs[i].datastart == n.image.datastart;
+        }
+        for (size_t j = 0; j < i; j++) {
+            shared |= outputs[i].datastart == outputs[j].datastart;
+        }
+        if (shared) outputs[i].release();
+        outputs[i].create(size, nodes[result].op == GraphOp::LogAmplify ? CV_8SC1 : CV_8UC1);
+        plans[result].result_output = (int)i;
+    }
+
+    for (int step = 0; step < (int)steps.size(); step++) {
+        Node node = steps[step];
+        const GraphNode &n = nodes[node];
+        Plan &plan = plans[node];
+        if (n.op == GraphOp::Input) {
+            plan.buffer = n.image;
+        } else {
+            if (plan.result_output >= 0) {
+                plan.buffer = outputs[plan.result_output];
+            } else {
+                plan.buffer = acquire(n.op == GraphOp::LogAmplify ? CV_8SC1 : CV_8UC1);
+            }
+            cv::parallel_for_(cv::Range(0, size.height), [&](const cv::Range &range) {
+                thread_local Scratch scratch;
+                if (scratch.rows.size() < nodes.size()) scratch.rows.resize(nodes.size());
+                for (int y = range.start; y < range.end; y++) {
+                    compute_row(node, y, plan.buffer.ptr<uchar>(y), scratch);
+                }
+            });
+        }
+        // The range of this buffer is now known, so log_amplify nodes reading it can build their tables
+        for (Node other: order) {
+            if (nodes[other].op == GraphOp::LogAmplify && nodes[other].inputs[0] == node) {
+                build_log_table(other);
+            }
+        }
+
+        // Give back the buffers nothing reads any more
+        for (int done = 0; done < step; done++) {
+            Plan &input = plans[steps[done]];
+            if (input.last_use == step && !input.result && nodes[steps[done]].op != GraphOp::Input) {
+                release(input.buffer);
+            }
+        }
+    }
+
+    // Input results and repeated results share the buffer computed for them
+    for (size_t i = 0; i < results.size(); i++) {
+        outputs[i] = plans[results[i]].buffer;
+    }
+    plans.clear();
+}
+
+#endif //CV_LESSONS_FILTER_GRAPH_H
@@ -0,0 +1,101 @@
+#ifndef CV_LESSONS_FILTERS_H
+#define CV_LESSONS_FILTERS_H
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include "box_filter.h"
+#include "fixed_point.h"
+#include "iir_gaussian.h"
+#include "metrics.h"
+#include "stencil.h"
+#include "unsharp.h"
+
+
+inline double compare_img(cv::Mat first, cv::Mat second) {
+    assert(first.cols == second.cols && first.rows == second.rows);
+    if (first.type() == CV_8UC1 && second.type() == CV_8UC1) {
+        // Both sums in one pass, without the absdiff image
+        ImageMetrics metrics = image_metrics(first, second, 0);
+        return 100 - 100 * (float)metrics.sad / metrics.reference;
+    }
+    cv::Mat res;
+    cv::absdiff(first, second, res);
+    return 100 - 100 * (float)cv::sum(res)[0] / cv::sum(second)[0];
+}
+
+inline cv::Mat img_diff(cv::Mat first, cv::Mat second) {
+    cv::Mat diff;
+    cv::absdiff(first, second, diff);
+    return diff;
+}
+
+// log_amplify of each of the 256 values of an 8-bit image. Log is monotonic, so the
+// entries between the minimum and maximum of src normalize exactly like src itself.
+inline cv::Mat log_amplify_table(const cv::Mat &src) {
+    double min_value, max_value;
+    cv::minMaxLoc(src, &min_value, &max_value);
+    cv::Mat table(1, 256, CV_32F), mask = cv::Mat::zeros(1, 256, CV_8U);
+    for (int i = 0; i < 256; i++) table.at<float>(i) = (float)i;
+    mask.colRange((int)min_value, (int)max_value + 1).setTo(1);
+    cv::log(table + 1, table);
+    cv::normalize(table, table, 0, 255, cv::NORM_MINMAX, -1, mask);
+    table.convertTo(table, CV_8S);
+    return table;
+}
+
+inline cv::Mat log_amplify(cv::Mat src) {
+    if (src.type() == CV_8UC1) {
+        // An 8-bit image has at most 256 distinct values, look them up instead of
+        // widening the whole image to float
+        cv::Mat ampl;
+        cv::LUT(src, log_amplify_table(src), ampl);
+        return ampl;
+    }
+    cv::Mat ampl = src.clone();
+    ampl.convertTo(ampl, CV_32F);
+    cv::log(ampl + 1, ampl);
+    cv::normalize(ampl, ampl, 0, 255, cv::NORM_MINMAX);
+    ampl.convertTo(ampl, CV_8S);
+    return ampl;
+}
+
+
+inline cv::Mat box_filter(cv::Mat img, ushort box_size=3) {
+    assert(!img.empty() && img.channels() == 1 && box_size % 2 != 0 && box_size >= 3);
+    cv::Mat box_filter;
+    if (img.type() == CV_8UC1 && stencil_box_filter(img, box_filter, box_size)) {
+        return box_filter;
+    }
+    cv::Mat kernel = cv::Mat::ones(box_size, box_size, CV_32F) / (box_size * box_size);
+    filter2D(img, box_filter, -1, kernel);
+    return box_filter;
+}
+
+inline cv::Mat unsharp_mask(cv::Mat img, double alpha = 0.5) {
+    return fused_unsharp_box(img, 3, alpha);
+}
+
+inline cv::Mat unsharp_mask_gaussian(cv::Mat img, double alpha = 0.5) {
+    return fused_unsharp_gaussian(img, 5, alpha);
+}
+
+
+inline cv::Mat laplace_filter(cv::Mat img, int ksize = 3) {
+    assert(!img.empty() && img.channels() == 1 && ksize % 2 != 0 && ksize >= 3);
+    cv::Mat laplace;
+    if (img.type() == CV_8UC1 && stencil_laplace_filter(img, laplace, ksize)) {
+        return laplace;
+    }
+    cv::Mat kernel = cv::Mat::ones(ksize, ksize, CV_32F) * -1;
+    kernel.at<float>(ksize / 2, ksize / 2) = (float)(ksize * ksize - 1);
+    filter2D(img, laplace, -1, kernel);
+    return laplace;
+}
+
+
+inline cv::Mat unsharp_laplasian(cv::Mat img, double alpha = 0.3) {
+    return fused_unsharp_laplace(img, 3, alpha);
+}
+
+#endif //CV_LESSONS_FILTERS_H
@@ -0,0 +1,332 @@
+#ifndef CV_LESSONS_FIXED_POINT_H
+#define CV_LESSONS_FIXED_POINT_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "opencv2/core.hpp"
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+
+// Integer filtering of CV_8UC1 images. A ksize x ksize window sum of 8-bit pixels is at
+// most 15 * 15 * 255 = 57375, so for ksize <= 15 both the column sums and the window sums
+// fit in uint16 and SIMD registers hold twice as many lanes as with float. Every result
+// is an exact integer function of the window sum, so the vector and scalar paths agree
+// bit for bit:
+//   box:     round(S / k^2)
+//   laplace: saturate(k^2 * c - S), the laplace_filter kernel without forming it
+//   unsharp: saturate(c + round(alpha_q * (c - box) / 256)), alpha in Q8 fixed point
+// Borders are reflected like BORDER_REFLECT_101.
+//
+// Column sums run down each band of rows, adding the entering row and subtracting the
+// leaving one, and the scalar window sums slide along the row, so the cost per pixel
+// does not grow with ksize outside the short vector sums. The vector paths use SSE2,
+// which every x86-64 CPU has, and AVX2 when built with CV_LESSONS_NATIVE.
+
+constexpr int FIXED_MAX_KSIZE = 15;
+
+enum class FixedFilter {Box, Laplace, Unsharp};
+
+// x / d rounded to nearest. d = k^2 is odd, so x / d is never halfway between integers
+// and the float reciprocal is exact enough for every x < 2^16.
+inline int fixed_divide(uint32_t x, float scale) {
+    return (int)((float)x * scale + 0.5f);
+}
+
+// alpha in Q8; alpha_q * diff must fit the 16-bit products and the 32-bit sums below
+inline int fixed_alpha(double alpha) {
+    int alpha_q = (int)std::lround(alpha * 256);
+    assert(alpha_q >= 0 && alpha_q <= 32767);
+    return alpha_q;
+}
+
+// dst[x] = sum of rows[i][x] over the ksize rows
+inline void fixed_column_sums(const uchar *const *rows, int ksize, int width, uint16_t *dst) {
+    int x = 0;
+#if defined(__AVX2__)
+    for (; x + 16 <= width; x += 16) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < ksize; i++) {
+            sum = _mm256_add_epi16(sum, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(rows[i] + x))));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + x), sum);
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    for (; x + 8 <= width; x += 8) {
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < ksize; i++) {
+            __m128i bytes = _mm_loadl_epi64((const __m128i *)(rows[i] + x));
+            sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(bytes, _mm_setzero_si128()));
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), sum);
+    }
+#endif
+    for (; x < width; x++) {
+        uint16_t sum = 0;
+        for (int i = 0; i < ksize; i++) sum += rows[i][x];
+        dst[x] = sum;
+    }
+}
+
+// dst[x] += entering[x] - leaving[x], moves column sums one row down
+inline void fixed_slide_column_sums(const uchar *entering, const uchar *leaving, int width, uint16_t *dst) {
+    int x = 0;
+#if defined(__AVX2__)
+    for (; x + 16 <= width; x += 16) {
+        __m256i e = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(entering + x)));
+        __m256i l = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(leaving + x)));
+        __m256i sum = _mm256_loadu_si256((const __m256i *)(dst + x));
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_add_epi16(_mm256_sub_epi16(sum, l), e));
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    for (; x + 8 <= width; x += 8) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i e = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(entering + x)), zero);
+        __m128i l = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(leaving + x)), zero);
+        __m128i sum = _mm_loadu_si128((const __m128i *)(dst + x));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_add_epi16(_mm_sub_epi16(sum, l), e));
+    }
+#endif
+    for (; x < width; x++) {
+        dst[x] = (uint16_t)(dst[x] + entering[x] - leaving[x]);
+    }
+}
+
+// dst[x] = sum of padded[x + j] over the ksize taps, padded holds ksize - 1 extra values
+inline void fixed_window_sums(const uint16_t *padded, int ksize, int width, uint16_t *dst) {
+    int x = 0;
+#if defined(__AVX2__)
+    for (; x + 16 <= width; x += 16) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int j = 0; j < ksize; j++) {
+            sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i *)(padded + x + j)));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + x), sum);
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    for (; x + 8 <= width; x += 8) {
+        __m128i sum = _mm_setzero_si128();
+        for (int j = 0; j < ksize; j++) {
+            sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i *)(padded + x + j)));
+        }
+        _mm_storeu_si128((__m128i *)(dst + x), sum);
+    }
+#endif
+    if (x == width) return;
+    // Running sum over the rest, uint16 wraps but every window sum fits
+    uint16_t sum = 0;
+    for (int j = 0; j < ksize; j++) sum += padded[x + j];
+    dst[x] = sum;
+    for (x++; x < width; x++) {
+        sum += padded[x + ksize - 1] - padded[x - 1];
+        dst[x] = sum;
+    }
+}
+
+#if defined(__AVX2__)
+// Sixteen uint16 window sums divided by the box area with rounding, still as uint16
+inline __m256i fixed_divide_16(__m256i sums, float scale) {
+    const __m256 vscale = _mm256_set1_ps(scale), half = _mm256_set1_ps(0.5f);
+    __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(sums));
+    __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(sums, 1));
+    lo = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(lo), vscale), half));
+    hi = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(hi), vscale), half));
+    // packus works within 128-bit lanes, the permute restores the element order
+    return _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xd8);
+}
+
+// Packs sixteen int16 values in 0..255 to bytes
+inline void fixed_store_16(uchar *dst, __m256i values) {
+    __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+    _mm_storeu_si128((__m128i *)dst, packed);
+}
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+// fixed_divide_16 on eight lanes with SSE2 only
+inline __m128i fixed_divide_8(__m128i sums, float scale) {
+    const __m128 vscale = _mm_set1_ps(scale), half = _mm_set1_ps(0.5f);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(sums, zero)), vscale), half));
+    __m128i hi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(sums, zero)), vscale), half));
+    // The quotients are at most 255, so the signed pack is exact
+    return _mm_packs_epi32(lo, hi);
+}
+#endif
+
+inline void fixed_finish_row(FixedFilter filter, const uchar *center, const uint16_t *sums, int width, int ksize,
+                             int alpha_q, uchar *dst) {
+    const int area = ksize * ksize;
+    const float scale = 1.f / (float)area;
+    int x = 0;
+#if defined(__AVX2__)
+    const __m256i vmax = _mm256_set1_epi16(255), varea = _mm256_set1_epi16((short)area);
+    const __m256i valpha = _mm256_set1_epi16((short)alpha_q), round = _mm256_set1_epi32(128);
+    for (; x + 16 <= width; x += 16) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(sums + x));
+        __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(center + x)));
+        __m256i result;
+        if (filter == FixedFilter::Box) {
+            result = fixed_divide_16(s, scale);
+        } else if (filter == FixedFilter::Laplace) {
+            // k^2 * c <= 57375 fits uint16, subs_epu16 saturates negative results to 0
+            result = _mm256_min_epu16(_mm256_subs_epu16(_mm256_mullo_epi16(c, varea), s), vmax);
+        } else {
+            __m256i diff = _mm256_sub_epi16(c, fixed_divide_16(s, scale));
+            // alpha_q * diff needs 32 bits, rebuild them from the low and high halves of the products
+            __m256i lo16 = _mm256_mullo_epi16(diff, valpha), hi16 = _mm256_mulhi_epi16(diff, valpha);
+            __m256i lo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(lo16, hi16), round), 8);
+            __m256i hi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(lo16, hi16), round), 8);
+            // unpack and packs both work within 128-bit lanes, so the order comes out right
+            result = _mm256_adds_epi16(c, _mm256_packs_epi32(lo, hi));
+            result = _mm256_min_epi16(_mm256_max_epi16(result, _mm256_setzero_si256()), vmax);
+        }
+        fixed_store_16(dst + x, result);
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    const __m128i zero = _mm_setzero_si128(), max8 = _mm_set1_epi16(255), area8 = _mm_set1_epi16((short)area);
+    const __m128i alpha8 = _mm_set1_epi16((short)alpha_q), round8 = _mm_set1_epi32(128);
+    for (; x + 8 <= width; x += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(sums + x));
+        __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(center + x)), zero);
+        __m128i result;
+        if (filter == FixedFilter::Box) {
+            result = fixed_divide_8(s, scale);
+        } else if (filter == FixedFilter::Laplace) {
+            __m128i value = _mm_subs_epu16(_mm_mullo_epi16(c, area8), s);
+            // SSE2 has no unsigned 16-bit min, v - saturate(v - 255) is min(v, 255)
+            result = _mm_sub_epi16(value, _mm_subs_epu16(value, max8));
+        } else {
+            __m128i diff = _mm_sub_epi16(c, fixed_divide_8(s, scale));
+            __m128i lo16 = _mm_mullo_epi16(diff, alpha8), hi16 = _mm_mulhi_epi16(diff, alpha8);
+            __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo16, hi16), round8), 8);
+            __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo16, hi16), round8), 8);
+            result = _mm_adds_epi16(c, _mm_packs_epi32(lo, hi));
+            result = _mm_min_epi16(_mm_max_epi16(result, zero), max8);
+        }
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(result, result));
+    }
+#endif
+    for (; x < width; x++) {
+        int value;
+        if (filter == FixedFilter::Box) {
+            value = fixed_divide(sums[x], scale);
+        } else if (filter == FixedFilter::Laplace) {
+            value = area * center[x] - sums[x];
+        } else {
+            // >> on a negative int is an arithmetic shift, i.e. floor, on every supported compiler
+            value = center[x] + ((alpha_q * (center[x] - fixed_divide(sums[x], scale)) + 128) >> 8);
+        }
+        dst[x] = (uchar)std::clamp(value, 0, 255);
+    }
+}
+
+// Finishes row y from its column sums, which sit in padded after radius free slots
+inline void fixed_finish_from_columns(const cv::Mat &src, int y, FixedFilter filter, int ksize, int alpha_q,
+                                      std::vector<uint16_t> &padded, std::vector<uint16_t> &sums, uchar *dst) {
+    const int width = src.cols, radius = ksize / 2;
+    uint16_t *columns = padded.data() + radius;
+    sums.resize(width);
+    for (int j = 1; j <= radius; j++) {
+        columns[-j] = columns[cv::borderInterpolate(-j, width, cv::BORDER_REFLECT_101)];
+        columns[width - 1 + j] = columns[cv::borderInterpolate(width - 1 + j, width, cv::BORDER_REFLECT_101)];
+    }
+    fixed_window_sums(padded.data(), ksize, width, sums.data());
+    fixed_finish_row(filter, src.ptr<uchar>(y), sums.data(), width, ksize, alpha_q, dst);
+}
+
+// Filters row y of src into dst on its own, padded and sums are scratch buffers reused between rows
+inline void fixed_filter_row(const cv::Mat &src, int y, FixedFilter filter, int ksize, int alpha_q,
+                             std::vector<uint16_t> &padded, std::vector<uint16_t> &sums, uchar *dst) {
+    const int width = src.cols, height = src.rows, radius = ksize / 2;
+    const uchar *rows[FIXED_MAX_KSIZE];
+    padded.resize(width + 2 * radius);
+    for (int i = 0; i < ksize; i++) {
+        rows[i] = src.ptr<uchar>(cv::borderInterpolate(y + i - radius, height, cv::BORDER_REFLECT_101));
+    }
+    fixed_column_sums(rows, ksize, width, padded.data() + radius);
+    fixed_finish_from_columns(src, y, filter, ksize, alpha_q, padded, sums, dst);
+}
+
+// Filters a band of rows; the column sums of the first row are summed in full and then
+// slide down the band one row at a time
+inline void fixed_filter_rows(const cv::Mat &src, cv::Mat &dst, FixedFilter filter, int ksize, int alpha_q,
+                              int row_begin, int row_end) {
+    const int height = src.rows, radius = ksize / 2;
+    auto row = [&](int v) { return src.ptr<uchar>(cv::borderInterpolate(v, height, cv::BORDER_REFLECT_101)); };
+    std::vector<uint16_t> padded, sums;
+    for (int y = row_begin; y < row_end; y++) {
+        if (y == row_begin) {
+            fixed_filter_row(src, y, filter, ksize, alpha_q, padded, sums, dst.ptr<uchar>(y));
+        } else {
+            fixed_slide_column_sums(row(y + radius), row(y - radius - 1), src.cols, padded.data() + radius);
+            fixed_finish_from_columns(src, y, filter, ksize, alpha_q, padded, sums, dst.ptr<uchar>(y));
+        }
+    }
+}
+
+inline cv::Mat fixed_filter(const cv::Mat &img, FixedFilter filter, int ksize, double alpha = 0) {
+    assert(!img.empty() && img.type() == CV_8UC1 && ksize % 2 == 1 && ksize >= 3 && ksize <= FIXED_MAX_KSIZE);
+    int alpha_q = fixed_alpha(alpha);
+    cv::Mat result(img.size(), img.type());
+    cv::parallel_for_(cv::Range(0, img.rows), [&](const cv::Range &range) {
+        fixed_filter_rows(img, result, filter, ksize, alpha_q, range.start, range.end);
+    });
+    return result;
+}
+
+inline cv::Mat box_filter_fixed(const cv::Mat &img, int ksize = 3) {
+    return fixed_filter(img, FixedFilter::Box, ksize);
+}
+
+inline cv::Mat laplace_filter_fixed(const cv::Mat &img, int ksize = 3) {
+    return fixed_filter(img, FixedFilter::Laplace, ksize);
+}
+
+inline cv::Mat unsharp_mask_fixed(const cv::Mat &img, int ksize = 3, double alpha = 0.5) {
+    return fixed_filter(img, FixedFilter::Unsharp, ksize, alpha);
+}
+
+// The formulas at the top evaluated directly, one full window sum per pixel in int64 and
+// the rounding done in exact integer arithmetic. Slow; lab2 --check-fixed compares the
+// fast paths with it.
+inline cv::Mat fixed_filter_reference(const cv::Mat &img, FixedFilter filter, int ksize, double alpha = 0) {
+    assert(!img.empty() && img.type() == CV_8UC1 && ksize % 2 == 1 && ksize >= 3 && ksize <= FIXED_MAX_KSIZE);
+    const int alpha_q = fixed_alpha(alpha), radius = ksize / 2;
+    const int64_t area = (int64_t)ksize * ksize;
+    cv::Mat result(img.size(), img.type());
+    for (int y = 0; y < img.rows; y++) {
+        for (int x = 0; x < img.cols; x++) {
+            int64_t sum = 0;
+            for (int dy = -radius; dy <= radius; dy++) {
+                const uchar *row = img.ptr<uchar>(cv::borderInterpolate(y + dy, img.rows, cv::BORDER_REFLECT_101));
+                for (int dx = -radius; dx <= radius; dx++) {
+                    sum += row[cv::borderInterpolate(x + dx, img.cols, cv::BORDER_REFLECT_101)];
+                }
+            }
+            const int64_t center = img.at<uchar>(y, x), box = (2 * sum + area) / (2 * area);
+            int64_t value;
+            if (filter == FixedFilter::Box) {
+                value = box;
+            } else if (filter == FixedFilter::Laplace) {
+                value = area * center - sum;
+            } else {
+                // floor((n + 128) / 256) without relying on the sign of n
+                int64_t n = alpha_q * (center - box) + 128;
+                value = center + (n >= 0 ? n / 256 : -((-n + 255) / 256));
+            }
+            result.at<uchar>(y, x) = (uchar)std::clamp<int64_t>(value, 0, 255);
+        }
+    }
+    return result;
+}
+
+#endif //CV_LESSONS_FIXED_POINT_H
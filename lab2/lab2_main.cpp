@@ -1,76 +1,147 @@
 #include <iostream>
 #include <chrono>
 #include <algorithm>
+#include <tuple>
 #include "opencv2/core.hpp"
 #include "opencv2/imgcodecs.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/highgui.hpp"
 #include "opencv2/core/utils/logger.hpp"
 
-
-double compare_img(cv::Mat first, cv::Mat second) {
-    assert(first.cols == second.cols && first.rows == second.rows);
-    cv::Mat res;
-    cv::absdiff(first, second, res);
-    return 100 - 100 * (float)cv::sum(res)[0] / cv::sum(second)[0];
+#include "filters.h"
+#include "filter_graph.h"
+#include "streaming.h"
+
+
+// lab2 --stream box|gaussian|laplace|unsharp|unsharp_gaussian|unsharp_laplace KSIZE IN.pgm OUT.pgm [BAND_ROWS]
+int run_streaming(int argc, char **argv) {
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0] << " --stream FILTER KSIZE IN.pgm OUT.pgm [BAND_ROWS]" << std::endl;
+        return 1;
+    }
+    std::string name = argv[2];
+    int ksize = std::stoi(argv[3]);
+    BandFilter filter;
+    if (name == "box") filter = band_box_filter(ksize);
+    else if (name == "gaussian") filter = band_gaussian_blur(ksize);
+    else if (name == "laplace") filter = band_laplace_filter(ksize);
+    else if (name == "unsharp") filter = band_unsharp_box(ksize);
+    else if (name == "unsharp_gaussian") filter = band_unsharp_gaussian(ksize);
+    else if (name == "unsharp_laplace") filter = band_unsharp_laplace(ksize);
+    else {
+        std::cerr << "Unknown filter " << name << std::endl;
+        return 1;
+    }
+    StreamOptions options;
+    if (argc > 6) options.band_rows = std::stoi(argv[6]);
+
+    auto start = std::chrono::steady_clock::now();
+    if (!stream_filter(argv[4], argv[5], filter, options)) {
+        std::cerr << "Could not filter " << argv[4] << " into " << argv[5] << std::endl;
+        return 1;
+    }
+    std::cout << "Streaming " << name << " filter execution time: " << std::chrono::steady_clock::now() - start
+              << std::endl;
+    return 0;
 }
 
-cv::Mat img_diff(cv::Mat first, cv::Mat second) {
-    cv::Mat diff;
-    cv::absdiff(first, second, diff);
-    return diff;
-}
 
-cv::Mat log_amplify(cv::Mat src) {
-    cv::Mat ampl = src.clone();
-    ampl.convertTo(ampl, CV_32F);
-    cv::log(ampl + 1, ampl);
-    cv::normalize(ampl, ampl, 0, 255, cv::NORM_MINMAX);
-    ampl.convertTo(ampl, CV_8S);
-    return ampl;
+// lab2 --check-golden DIR [--update]: compares the filter outputs for lenna with DIR/<filter>.png
+int run_golden_check(int argc, char **argv, const cv::Mat &grayscale) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " --check-golden DIR [--update]" << std::endl;
+        return 1;
+    }
+    std::string dir = argv[2];
+    bool update = argc > 3 && std::string(argv[3]) == "--update";
+    std::vector<std::pair<std::string, cv::Mat>> outputs = {
+            {"box_filter", box_filter(grayscale, 5)},
+            {"laplace_filter", laplace_filter(grayscale)},
+            {"unsharp_mask", unsharp_mask(grayscale)},
+            {"unsharp_mask_gaussian", unsharp_mask_gaussian(grayscale)},
+            {"unsharp_laplasian", unsharp_laplasian(grayscale)},
+            {"box_filter_fast", box_filter_fast(grayscale, 5)},
+            {"box_filter_fixed", box_filter_fixed(grayscale, 5)},
+            {"unsharp_mask_fixed", unsharp_mask_fixed(grayscale)},
+            {"iir_gaussian_blur", iir_gaussian_blur(grayscale, 4)},
+            {"unsharp_mask_iir", unsharp_mask_iir(grayscale, 4)},
+    };
+    std::vector<RegressionCase> cases;
+    for (auto &[name, output]: outputs) {
+        cases.push_back({name, output, dir + "/" + name + ".png"});
+    }
+    int failures = report_regressions(check_against_golden(cases, {}, update));
+    return failures ? 1 : 0;
 }
 
 
-cv::Mat box_filter(cv::Mat img, ushort box_size=3) {
-    assert(!img.empty() && img.channels() == 1 && box_size % 2 != 0 && box_size >= 3);
-    cv::Mat box_filter;
-    cv::Mat kernel = cv::Mat::ones(box_size, box_size, CV_32F) / (box_size * box_size);
-    filter2D(img, box_filter, -1, kernel);
-    return box_filter;
+// lab2 --check-fixed: the fixed-point filters against fixed_filter_reference, on lenna and on
+// noise whose width leaves a scalar tail after every vector loop
+int run_fixed_check(const cv::Mat &grayscale) {
+    cv::Mat noise(203, 517, CV_8UC1);
+    cv::RNG(7).fill(noise, cv::RNG::UNIFORM, 0, 256);
+    const std::vector<std::tuple<const char *, FixedFilter, double>> filters = {
+            {"box", FixedFilter::Box, 0}, {"laplace", FixedFilter::Laplace, 0},
+            {"unsharp", FixedFilter::Unsharp, 0.5}, {"unsharp", FixedFilter::Unsharp, 3.9},
+    };
+    int failures = 0;
+    for (const cv::Mat &img: {grayscale, noise}) {
+        for (auto &[name, filter, alpha]: filters) {
+            for (int ksize = 3; ksize <= FIXED_MAX_KSIZE; ksize += 2) {
+                cv::Mat fast = fixed_filter(img, filter, ksize, alpha);
+                cv::Mat exact = fixed_filter_reference(img, filter, ksize, alpha);
+                int mismatches = 0;
+                for (int y = 0; y < img.rows; y++) {
+                    for (int x = 0; x < img.cols; x++) mismatches += fast.at<uchar>(y, x) != exact.at<uchar>(y, x);
+                }
+                if (mismatches) {
+                    std::cerr << name << " ksize " << ksize << " alpha " << alpha << " on " << img.cols << "x"
+                              << img.rows << ": " << mismatches << " pixels differ" << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+    std::cout << (failures ? "Fixed-point filters differ from the reference" : "Fixed-point filters match the reference")
+              << std::endl;
+    return failures ? 1 : 0;
 }
 
-cv::Mat unsharp_mask(cv::Mat img, double alpha = 0.5) {
-    return img + alpha * (img - box_filter(img));
-}
-
-cv::Mat unsharp_mask_gaussian(cv::Mat img, double alpha = 0.5) {
-    cv::Mat gaussian;
-    cv::GaussianBlur(img, gaussian, {5, 5}, (0, 0));
-    return img + alpha * (img - gaussian);
-}
 
-
-cv::Mat laplace_filter(cv::Mat img, int ksize = 3) {
-    assert(!img.empty() && img.channels() == 1 && ksize % 2 != 0 && ksize >= 3);
-    cv::Mat laplace;
-    cv::Mat kernel = cv::Mat::ones(ksize, ksize, CV_32F) * -1;
-    kernel.at<float>(ksize / 2, ksize / 2) = (float)(ksize * ksize - 1);
-    filter2D(img, laplace, -1, kernel);
-    return laplace;
+// Recursive against FIR Gaussian blur: the IIR time stays flat while the FIR one grows with sigma
+void compare_iir_gaussian(const cv::Mat &grayscale) {
+    using std::chrono::steady_clock;
+    for (double sigma: {1.0, 2.0, 5.0, 10.0, 20.0}) {
+        cv::Mat fir;
+        auto start = steady_clock::now();
+        // ksize 0 lets OpenCV cover +-3 sigma, the border matches the IIR one
+        cv::GaussianBlur(grayscale, fir, {0, 0}, sigma, sigma, cv::BORDER_REPLICATE);
+        auto fir_time = steady_clock::now() - start;
+        start = steady_clock::now();
+        cv::Mat iir = iir_gaussian_blur(grayscale, sigma);
+        auto iir_time = steady_clock::now() - start;
+        std::cout << "Gaussian sigma " << sigma << ": FIR " << fir_time << ", IIR " << iir_time << ", "
+                  << image_metrics(iir, fir) << std::endl;
+    }
 }
 
 
-cv::Mat unsharp_laplasian(cv::Mat img, double alpha = 0.3) {
-    return img + alpha * laplace_filter(img);
-}
-
-int main() {
+int main(int argc, char **argv) {
     cv::utils::logging::setLogLevel(cv::utils::logging::LogLevel::LOG_LEVEL_ERROR);
+    if (argc > 1 && std::string(argv[1]) == "--stream") {
+        return run_streaming(argc, argv);
+    }
     using std::chrono::steady_clock;
 
     cv::Mat original = cv::imread("../lab2/lenna.png");
     cv::Mat grayscale;
     cv::cvtColor(original, grayscale, cv::COLOR_BGR2GRAY);
+    if (argc > 1 && std::string(argv[1]) == "--check-golden") {
+        return run_golden_check(argc, argv, grayscale);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--check-fixed") {
+        return run_fixed_check(grayscale);
+    }
 
     auto start = steady_clock::now();
     auto diy_box_filter = box_filter(grayscale, 5);
@@ -83,18 +154,29 @@ int main() {
 
     std::cout << "Difference between DIY and opencv methods: " << compare_img(diy_box_filter, box_filter_opencv) << std::endl;
 
+    start = steady_clock::now();
+    auto running_sum_box_filter = box_filter_fast(grayscale, 5);
+    std::cout << "Running sum box filter execution time: " << steady_clock::now() - start << std::endl;
+    std::cout << "Difference between running sum and opencv methods: "
+              << compare_img(running_sum_box_filter, box_filter_opencv) << std::endl;
+
     cv::Mat gaussian;
     cv::GaussianBlur(grayscale, gaussian, {5, 5}, (0, 0));
 
     std::cout << "Difference between DIY and gaussian methods: " << compare_img(diy_box_filter, gaussian) << std::endl;
+    compare_iir_gaussian(grayscale);
 
     cv::imshow("grayscale original", grayscale);
-    cv::imshow("diy box filter", box_filter(grayscale, 5));
+    cv::imshow("diy box filter", diy_box_filter);
     cv::imshow("opencv box filter", box_filter_opencv);
 
     cv::imshow("gaussian blur", gaussian);
-    cv::imshow("gaussian box diff", img_diff(diy_box_filter, gaussian));
-    cv::imshow("log difference", log_amplify(img_diff(diy_box_filter, gaussian)));
+    // Both views of the difference come from one lazy graph, the difference is computed once
+    FilterGraph graph;
+    auto box_gaussian_diff = graph.absdiff(graph.input(diy_box_filter), graph.input(gaussian));
+    auto diff_views = graph.evaluate({box_gaussian_diff, graph.log_amplify(box_gaussian_diff)});
+    cv::imshow("gaussian box diff", diff_views[0]);
+    cv::imshow("log difference", diff_views[1]);
 
     cv::Mat unsharp_box = unsharp_mask(grayscale);
     cv::Mat unsharp_gaussian = unsharp_mask_gaussian(grayscale);
@@ -0,0 +1,276 @@
+#ifndef CV_LESSONS_METRICS_H
+#define CV_LESSONS_METRICS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/imgcodecs.hpp"
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+
+// Image quality metrics of two CV_8UC1 images in a single pass without temporaries.
+// Rows are split into bands processed in parallel. Each band adds up |a - b|, (a - b)^2
+// and the reference pixels row by row, and slides an SSIM window down the same rows,
+// keeping per-column sums of a, b, a^2, b^2 and ab that are updated with the entering
+// and leaving row. SSIM uses a uniform window over every position where it fits, with the usual
+// constants C1 = (0.01 * 255)^2 and C2 = (0.03 * 255)^2.
+// Column sums are int32, which holds window * 255^2 up to SSIM_MAX_WINDOW rows; window sums
+// reach window^2 * 255^2, which overflows int32 past a window of 181, so they are int64.
+
+constexpr int SSIM_MAX_WINDOW = 33025;
+
+struct ImageMetrics {
+    double sad = 0;        // sum of absolute differences
+    double reference = 0;  // sum of the reference (second) image
+    double mse = 0;
+    double psnr = std::numeric_limits<double>::infinity();  // dB, infinite for identical images
+    double ssim = 1;       // NaN when skipped
+};
+
+struct MetricSums {
+    uint64_t sad = 0, ssd = 0, reference = 0;
+    double ssim = 0;
+    int64_t windows = 0;
+};
+
+// Adds |a - b|, (a - b)^2 and b over one row
+inline void metric_row_sums(const uchar *a, const uchar *b, int width, MetricSums &sums) {
+    int x = 0;
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    // The 32-bit squared sums are flushed every 4096 pixels, long before they could overflow
+    while (x + 32 <= width) {
+        __m256i sad = zero, reference = zero, ssd = zero;
+        int block_end = std::min(width, x + 4096);
+        for (; x + 32 <= block_end; x += 32) {
+            __m256i va = _mm256_loadu_si256((const __m256i *)(a + x));
+            __m256i vb = _mm256_loadu_si256((const __m256i *)(b + x));
+            sad = _mm256_add_epi64(sad, _mm256_sad_epu8(va, vb));
+            reference = _mm256_add_epi64(reference, _mm256_sad_epu8(vb, zero));
+            __m256i lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero));
+            __m256i hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero));
+            ssd = _mm256_add_epi32(ssd, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+        }
+        alignas(32) uint64_t lanes64[4];
+        alignas(32) uint32_t lanes32[8];
+        _mm256_store_si256((__m256i *)lanes64, sad);
+        sums.sad += lanes64[0] + lanes64[1] + lanes64[2] + lanes64[3];
+        _mm256_store_si256((__m256i *)lanes64, reference);
+        sums.reference += lanes64[0] + lanes64[1] + lanes64[2] + lanes64[3];
+        _mm256_store_si256((__m256i *)lanes32, ssd);
+        for (uint32_t lane: lanes32) sums.ssd += lane;
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    // Same sums on 16 pixels with SSE2, which every x86-64 CPU has
+    const __m128i zero16 = _mm_setzero_si128();
+    while (x + 16 <= width) {
+        __m128i sad = zero16, reference = zero16, ssd = zero16;
+        int block_end = std::min(width, x + 4096);
+        for (; x + 16 <= block_end; x += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + x));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + x));
+            sad = _mm_add_epi64(sad, _mm_sad_epu8(va, vb));
+            reference = _mm_add_epi64(reference, _mm_sad_epu8(vb, zero16));
+            __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero16), _mm_unpacklo_epi8(vb, zero16));
+            __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero16), _mm_unpackhi_epi8(vb, zero16));
+            ssd = _mm_add_epi32(ssd, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+        }
+        alignas(16) uint64_t lanes64[2];
+        alignas(16) uint32_t lanes32[4];
+        _mm_store_si128((__m128i *)lanes64, sad);
+        sums.sad += lanes64[0] + lanes64[1];
+        _mm_store_si128((__m128i *)lanes64, reference);
+        sums.reference += lanes64[0] + lanes64[1];
+        _mm_store_si128((__m128i *)lanes32, ssd);
+        for (uint32_t lane: lanes32) sums.ssd += lane;
+    }
+#endif
+    for (; x < width; x++) {
+        int diff = a[x] - b[x];
+        sums.sad += (uint64_t)std::abs(diff);
+        sums.ssd += (uint64_t)(diff * diff);
+        sums.reference += b[x];
+    }
+}
+
+// Adds one row to the SSIM column sums, stored as the a, b, a^2, b^2 and ab columns one
+// after another; sign is +1 for the entering row and -1 for the leaving one. One loop
+// per column keeps the alias checks simple enough for the loops to vectorize.
+inline void ssim_column_update(const uchar *a, const uchar *b, int width, int sign, int32_t *columns) {
+    int32_t *sa = columns, *sb = sa + width, *saa = sb + width, *sbb = saa + width, *sab = sbb + width;
+    for (int x = 0; x < width; x++) sa[x] += sign * a[x];
+    for (int x = 0; x < width; x++) sb[x] += sign * b[x];
+    for (int x = 0; x < width; x++) saa[x] += sign * a[x] * a[x];
+    for (int x = 0; x < width; x++) sbb[x] += sign * b[x] * b[x];
+    for (int x = 0; x < width; x++) sab[x] += sign * a[x] * b[x];
+}
+
+// SSIM of one window from its sums over `area` pixels. Multiplying the means, variances
+// and covariance through by area^2 leaves a single division.
+inline double ssim_window(double area, double sa, double sb, double saa, double sbb, double sab) {
+    constexpr double C1 = (0.01 * 255) * (0.01 * 255), C2 = (0.03 * 255) * (0.03 * 255);
+    const double c1 = C1 * area * area, c2 = C2 * area * area;
+    double products = sa * sb;
+    double numerator = (2 * products + c1) * (2 * (area * sab - products) + c2);
+    double denominator = (sa * sa + sb * sb + c1) * (area * (saa + sbb) - sa * sa - sb * sb + c2);
+    return numerator / denominator;
+}
+
+// Pixel rows [row_begin, row_end) and the SSIM windows whose top row lies in the same range
+inline MetricSums metric_band(const cv::Mat &a, const cv::Mat &b, int window, int row_begin, int row_end) {
+    MetricSums sums;
+    const int width = a.cols;
+    for (int y = row_begin; y < row_end; y++) {
+        metric_row_sums(a.ptr<uchar>(y), b.ptr<uchar>(y), width, sums);
+    }
+
+    if (window == 0) return sums;
+    int top_end = std::min(row_end, a.rows - window + 1);
+    if (row_begin >= top_end) return sums;
+    const int out_width = width - window + 1;
+    std::vector<int32_t> columns(5 * (size_t)width, 0);
+    std::vector<int64_t> windows(5 * (size_t)out_width);
+    for (int y = row_begin; y < row_begin + window; y++) {
+        ssim_column_update(a.ptr<uchar>(y), b.ptr<uchar>(y), width, 1, columns.data());
+    }
+
+    // Per-column SSIM totals: the loops below stay free of reductions and vectorize
+    std::vector<double> ssim_sums(out_width, 0);
+    const double area = (double)window * window;
+    for (int top = row_begin; top < top_end; top++) {
+        for (int i = 0; i < 5; i++) {
+            const int32_t *column = columns.data() + (size_t)i * width;
+            int64_t *dst = windows.data() + (size_t)i * out_width;
+            std::copy(column, column + out_width, dst);
+            for (int j = 1; j < window; j++) {
+                for (int x = 0; x < out_width; x++) dst[x] += column[x + j];
+            }
+        }
+        const int64_t *wa = windows.data(), *wb = wa + out_width, *waa = wb + out_width, *wbb = waa + out_width,
+                *wab = wbb + out_width;
+        for (int x = 0; x < out_width; x++) {
+            ssim_sums[x] += ssim_window(area, (double)wa[x], (double)wb[x], (double)waa[x], (double)wbb[x],
+                                        (double)wab[x]);
+        }
+
+        if (top + 1 < top_end) {
+            ssim_column_update(a.ptr<uchar>(top), b.ptr<uchar>(top), width, -1, columns.data());
+            ssim_column_update(a.ptr<uchar>(top + window), b.ptr<uchar>(top + window), width, 1, columns.data());
+        }
+    }
+    for (double ssim: ssim_sums) sums.ssim += ssim;
+    sums.windows = (int64_t)out_width * (top_end - row_begin);
+    return sums;
+}
+
+// window is the SSIM window side, shrunk to fit images smaller than it and to
+// SSIM_MAX_WINDOW; 0 skips SSIM
+inline ImageMetrics image_metrics(const cv::Mat &a, const cv::Mat &b, int window = 7) {
+    assert(a.type() == CV_8UC1 && b.type() == CV_8UC1 && a.size() == b.size() && !a.empty());
+    window = std::max(0, std::min({window, a.rows, a.cols, SSIM_MAX_WINDOW}));
+
+    // A fixed number of bands, combined in band order, keeps even the floating point SSIM
+    // sum independent of the thread count
+    const int bands = std::min(a.rows, 64);
+    std::vector<MetricSums> partial(bands);
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range) {
+        for (int band = range.start; band < range.end; band++) {
+            int row_begin = (int)((int64_t)a.rows * band / bands), row_end = (int)((int64_t)a.rows * (band + 1) / bands);
+            partial[band] = metric_band(a, b, window, row_begin, row_end);
+        }
+    });
+
+    MetricSums total;
+    for (const MetricSums &sums: partial) {
+        total.sad += sums.sad;
+        total.ssd += sums.ssd;
+        total.reference += sums.reference;
+        total.ssim += sums.ssim;
+        total.windows += sums.windows;
+    }
+    ImageMetrics metrics;
+    double pixels = (double)a.total();
+    metrics.sad = (double)total.sad;
+    metrics.reference = (double)total.reference;
+    metrics.mse = (double)total.ssd / pixels;
+    if (total.ssd > 0) metrics.psnr = 10 * std::log10(255.0 * 255.0 / metrics.mse);
+    metrics.ssim = total.windows ? total.ssim / (double)total.windows : std::numeric_limits<double>::quiet_NaN();
+    return metrics;
+}
+
+inline std::ostream &operator<<(std::ostream &os, const ImageMetrics &metrics) {
+    return os << "SAD " << metrics.sad << ", MSE " << metrics.mse << ", PSNR " << metrics.psnr << " dB, SSIM "
+              << metrics.ssim;
+}
+
+
+// Regression checks of filter outputs against golden images stored as lossless files
+struct MetricThresholds {
+    double min_psnr = 40;
+    double min_ssim = 0.99;
+};
+
+struct RegressionCase {
+    std::string name;
+    cv::Mat output;
+    std::string golden_path;
+};
+
+struct RegressionResult {
+    std::string name;
+    ImageMetrics metrics;
+    bool passed = false;
+    std::string error;  // set when the golden image is missing or does not match in size
+};
+
+// Compares every output with its golden image. With update set, missing or failing golden
+// images are rewritten from the outputs instead, which is how the goldens are created.
+inline std::vector<RegressionResult> check_against_golden(const std::vector<RegressionCase> &cases,
+                                                          const MetricThresholds &thresholds = {},
+                                                          bool update = false) {
+    std::vector<RegressionResult> results;
+    for (const RegressionCase &test: cases) {
+        RegressionResult result;
+        result.name = test.name;
+        cv::Mat golden = cv::imread(test.golden_path, cv::IMREAD_GRAYSCALE);
+        if (golden.empty() || golden.size() != test.output.size()) {
+            result.error = golden.empty() ? "missing " + test.golden_path : "size differs from " + test.golden_path;
+        } else {
+            result.metrics = image_metrics(test.output, golden);
+            result.passed = result.metrics.psnr >= thresholds.min_psnr && result.metrics.ssim >= thresholds.min_ssim;
+        }
+        if (update && !result.passed) {
+            result.passed = cv::imwrite(test.golden_path, test.output);
+            result.error = result.passed ? "" : "could not write " + test.golden_path;
+            result.metrics = ImageMetrics();
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+// Prints one line per case and returns the number of failures
+inline int report_regressions(const std::vector<RegressionResult> &results, std::ostream &os = std::cout) {
+    int failures = 0;
+    for (const RegressionResult &result: results) {
+        os << (result.passed ? "PASS " : "FAIL ") << result.name << ": ";
+        if (result.error.empty()) {
+            os << result.metrics << std::endl;
+        } else {
+            os << result.error << std::endl;
+        }
+        failures += !result.passed;
+    }
+    return failures;
+}
+
+#endif //CV_LESSONS_METRICS_H
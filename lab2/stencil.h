@@ -0,0 +1,127 @@
+#ifndef CV_LESSONS_STENCIL_H
+#define CV_LESSONS_STENCIL_H
+
+#include <algorithm>
+#include <utility>
+#include "opencv2/core.hpp"
+
+
+// Stencil engine for small fixed kernels on CV_8UC1 images. The kernel is a type with a
+// compile-time size, integer weights and a divisor, so every tap is a constant: the tap
+// sum is a fold expression the compiler unrolls completely, zero taps vanish and the
+// loop over x vectorizes. Interior pixels never look at borders; the outer radius-wide
+// frame is filled by a separate scalar pass that reflects like BORDER_REFLECT_101.
+
+template<int K>
+struct BoxStencil {
+    static constexpr int size = K;
+    static constexpr int divisor = K * K;
+
+    static constexpr int weight(int, int) { return 1; }
+};
+
+// Same kernel as laplace_filter: -1 everywhere and ksize^2 - 1 in the middle
+template<int K>
+struct LaplaceStencil {
+    static constexpr int size = K;
+    static constexpr int divisor = 1;
+
+    static constexpr int weight(int row, int col) { return row == K / 2 && col == K / 2 ? K * K - 1 : -1; }
+};
+
+
+// Rounds sum / divisor to the nearest integer and saturates it to 0..255. With an odd
+// divisor sum / divisor is never exactly halfway, so the float reciprocal is exact enough.
+template<class S>
+inline int stencil_store(int sum) {
+    if constexpr (S::divisor != 1) {
+        sum = (int)((float)sum * (1.f / (float)S::divisor) + 0.5f);
+    }
+    return std::clamp(sum, 0, 255);
+}
+
+// rows[i] points at column x of source row y - radius + i, the window's top-left corner
+template<class S, size_t... I>
+inline int stencil_sum(const uchar *const *rows, int x, std::index_sequence<I...>) {
+    return (0 + ... + (S::weight((int)I / S::size, (int)I % S::size) * (int)rows[I / S::size][x + (int)I % S::size]));
+}
+
+template<class S>
+void stencil_interior_rows(const cv::Mat &src, cv::Mat &dst, int row_begin, int row_end) {
+    constexpr int K = S::size, radius = K / 2;
+    const int inner_width = src.cols - 2 * radius;
+    const uchar *rows[K];
+    for (int y = row_begin; y < row_end; y++) {
+        for (int i = 0; i < K; i++) {
+            rows[i] = src.ptr<uchar>(y - radius + i);
+        }
+        // dst never overlaps src, telling the compiler so lets it vectorize without alias checks
+        uchar *__restrict out = dst.ptr<uchar>(y) + radius;
+        for (int x = 0; x < inner_width; x++) {
+            out[x] = (uchar)stencil_store<S>(stencil_sum<S>(rows, x, std::make_index_sequence<K * K>()));
+        }
+    }
+}
+
+template<class S>
+int stencil_border_pixel(const cv::Mat &src, int y, int x) {
+    constexpr int K = S::size, radius = K / 2;
+    int sum = 0;
+    for (int i = 0; i < K; i++) {
+        const uchar *row = src.ptr<uchar>(cv::borderInterpolate(y - radius + i, src.rows, cv::BORDER_REFLECT_101));
+        for (int j = 0; j < K; j++) {
+            sum += S::weight(i, j) * row[cv::borderInterpolate(x - radius + j, src.cols, cv::BORDER_REFLECT_101)];
+        }
+    }
+    return stencil_store<S>(sum);
+}
+
+template<class S>
+void stencil_border(const cv::Mat &src, cv::Mat &dst) {
+    constexpr int radius = S::size / 2;
+    for (int y = 0; y < src.rows; y++) {
+        uchar *out = dst.ptr<uchar>(y);
+        bool full_row = y < radius || y >= src.rows - radius || src.cols <= 2 * radius;
+        for (int x = 0; x < src.cols; x++) {
+            if (!full_row && x == radius) {
+                x = src.cols - radius;  // skip the interior
+            }
+            out[x] = (uchar)stencil_border_pixel<S>(src, y, x);
+        }
+    }
+}
+
+template<class S>
+void stencil_filter(const cv::Mat &src, cv::Mat &dst) {
+    assert(src.type() == CV_8UC1);
+    constexpr int radius = S::size / 2;
+    dst.create(src.size(), src.type());
+    if (src.rows > 2 * radius && src.cols > 2 * radius) {
+        cv::parallel_for_(cv::Range(radius, src.rows - radius), [&](const cv::Range &range) {
+            stencil_interior_rows<S>(src, dst, range.start, range.end);
+        });
+    }
+    stencil_border<S>(src, dst);
+}
+
+
+// Dispatchers for the kernel sizes used in practice, false when ksize has no specialization
+inline bool stencil_box_filter(const cv::Mat &src, cv::Mat &dst, int ksize) {
+    switch (ksize) {
+        case 3: stencil_filter<BoxStencil<3>>(src, dst); return true;
+        case 5: stencil_filter<BoxStencil<5>>(src, dst); return true;
+        case 7: stencil_filter<BoxStencil<7>>(src, dst); return true;
+        default: return false;
+    }
+}
+
+inline bool stencil_laplace_filter(const cv::Mat &src, cv::Mat &dst, int ksize) {
+    switch (ksize) {
+        case 3: stencil_filter<LaplaceStencil<3>>(src, dst); return true;
+        case 5: stencil_filter<LaplaceStencil<5>>(src, dst); return true;
+        case 7: stencil_filter<LaplaceStencil<7>>(src, dst); return true;
+        default: return false;
+    }
+}
+
+#endif //CV_LESSONS_STENCIL_H
@@ -0,0 +1,208 @@
+#ifndef CV_LESSONS_STREAMING_H
+#define CV_LESSONS_STREAMING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include "filters.h"
+
+
+// Streaming filters for 8-bit grayscale images too large to load with imread. Images are
+// binary PGM (P5) files, whose pixel rows sit at fixed offsets, so every worker can read
+// its own rows directly. The image is cut into horizontal bands; a worker reads a band
+// together with `halo` rows above and below, runs an ordinary whole-image filter on it
+// and keeps only the band rows, which are exact because the halo covers the kernel.
+// Halos stop at the image edges, where the filter's own BORDER_REFLECT_101 handling
+// applies, so the output equals filtering the whole image at once. Bands are written
+// in order as they finish; at most one input and one output band per worker are alive.
+
+class PgmReader {
+    std::ifstream file;
+    std::streamoff data_offset = 0;
+
+public:
+    int width = 0, height = 0, max_value = 0;
+
+    bool open(const std::string &path);
+
+    void read_row(int y, uchar *dst);
+};
+
+class PgmWriter {
+    std::ofstream file;
+    int max_value = 255;
+    std::vector<uchar> clamped;
+
+public:
+    // max_value is written to the header and caps the pixels, as 255 caps 8-bit filter results
+    bool open(const std::string &path, int width, int height, int max_value = 255);
+
+    void write_rows(const cv::Mat &rows);
+
+    bool good() const { return (bool)file; }
+};
+
+
+inline bool PgmReader::open(const std::string &path) {
+    file.open(path, std::ios::binary);
+    std::string magic;
+    file >> magic;
+    // Comments may appear between the header fields
+    auto skip_comments = [&] {
+        while (file >> std::ws && file.peek() == '#') {
+            file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+    };
+    skip_comments();
+    file >> width;
+    skip_comments();
+    file >> height;
+    skip_comments();
+    file >> max_value;
+    file.get();  // exactly one whitespace character separates the header from the pixels
+    if (!file || magic != "P5" || width <= 0 || height <= 0 || max_value <= 0 || max_value > 255) {
+        return false;
+    }
+    data_offset = file.tellg();
+    return true;
+}
+
+inline void PgmReader::read_row(int y, uchar *dst) {
+    file.seekg(data_offset + (std::streamoff)y * width);
+    file.read((char *)dst, width);
+}
+
+inline bool PgmWriter::open(const std::string &path, int width, int height, int max_value) {
+    assert(max_value > 0 && max_value <= 255);
+    this->max_value = max_value;
+    file.open(path, std::ios::binary | std::ios::trunc);
+    file << "P5\n" << width << " " << height << "\n" << max_value << "\n";
+    return (bool)file;
+}
+
+inline void PgmWriter::write_rows(const cv::Mat &rows) {
+    for (int y = 0; y < rows.rows; y++) {
+        const uchar *row = rows.ptr<uchar>(y);
+        if (max_value < 255) {
+            clamped.resize(rows.cols);
+            for (int x = 0; x < rows.cols; x++) clamped[x] = std::min<uchar>(row[x], (uchar)max_value);
+            row = clamped.data();
+        }
+        file.write((const char *)row, rows.cols);
+    }
+}
+
+
+// A whole-image filter plus the number of rows of context it needs on each side
+struct BandFilter {
+    int halo = 0;
+    std::function<cv::Mat(const cv::Mat &)> apply;
+};
+
+inline BandFilter band_box_filter(int ksize) {
+    return {ksize / 2, [ksize](const cv::Mat &band) { return box_filter(band, (ushort)ksize); }};
+}
+
+// ksize 0 derives the size from sigma like GaussianBlur does for 8-bit images; the derived
+// size is passed on, so the halo always covers the kernel
+inline BandFilter band_gaussian_blur(int ksize, double sigma = 0) {
+    if (ksize <= 0) ksize = cvRound(sigma * 6 + 1) | 1;
+    return {ksize / 2, [ksize, sigma](const cv::Mat &band) {
+        cv::Mat result;
+        cv::GaussianBlur(band, result, {ksize, ksize}, sigma);
+        return result;
+    }};
+}
+
+inline BandFilter band_laplace_filter(int ksize) {
+    return {ksize / 2, [ksize](const cv::Mat &band) { return laplace_filter(band, ksize); }};
+}
+
+inline BandFilter band_unsharp_box(int ksize, double alpha = 0.5) {
+    return {ksize / 2, [ksize, alpha](const cv::Mat &band) { return fused_unsharp_box(band, ksize, alpha); }};
+}
+
+inline BandFilter band_unsharp_gaussian(int ksize, double alpha = 0.5) {
+    return {ksize / 2, [ksize, alpha](const cv::Mat &band) { return fused_unsharp_gaussian(band, ksize, alpha); }};
+}
+
+inline BandFilter band_unsharp_laplace(int ksize, double alpha = 0.3) {
+    return {ksize / 2, [ksize, alpha](const cv::Mat &band) { return fused_unsharp_laplace(band, ksize, alpha); }};
+}
+
+
+struct StreamOptions {
+    int band_rows = 256;
+    int threads = 0;  // 0 uses cv::getNumThreads()
+};
+
+// Filters the PGM image at input_path into output_path band by band.
+// Peak memory is about threads * (band_rows + 2 * halo) * width * 2 bytes plus filter temporaries.
+inline bool stream_filter(const std::string &input_path, const std::string &output_path, const BandFilter &filter,
+                          const StreamOptions &options = {}) {
+    PgmReader header;
+    if (!header.open(input_path)) return false;
+    const int width = header.width, height = header.height;
+    PgmWriter writer;
+    if (!writer.open(output_path, width, height, header.max_value)) return false;
+
+    const int band_rows = std::max(1, options.band_rows);
+    const int band_count = (height + band_rows - 1) / band_rows;
+    const int threads = std::max(1, std::min(options.threads > 0 ? options.threads : cv::getNumThreads(), band_count));
+
+    std::atomic<int> next_band{0};
+    std::atomic<bool> failed{false};
+    std::mutex mutex;
+    std::condition_variable band_written;
+    int next_to_write = 0;
+
+    // One stripe per worker; each worker pulls bands until none are left or a worker failed.
+    // A band that was taken still gets its turn to write, so no worker waits forever. The
+    // filters' own parallel_for_ calls run serially inside these stripes.
+    cv::parallel_for_(cv::Range(0, threads), [&](const cv::Range &range) {
+        for (int worker = range.start; worker < range.end; worker++) {
+            PgmReader reader;
+            if (!reader.open(input_path)) {
+                failed = true;
+                return;
+            }
+            cv::Mat band;
+            for (int idx; !failed && (idx = next_band++) < band_count;) {
+                int y_begin = idx * band_rows, y_end = std::min(height, y_begin + band_rows);
+                int halo_top = std::min(filter.halo, y_begin), halo_bottom = std::min(filter.halo, height - y_end);
+                band.create(y_end - y_begin + halo_top + halo_bottom, width, CV_8UC1);
+                if (!failed) {
+                    for (int y = 0; y < band.rows; y++) {
+                        reader.read_row(y_begin - halo_top + y, band.ptr<uchar>(y));
+                    }
+                }
+                cv::Mat filtered;
+                if (!failed) {
+                    filtered = filter.apply(band).rowRange(halo_top, halo_top + y_end - y_begin);
+                }
+
+                std::unique_lock<std::mutex> lock(mutex);
+                band_written.wait(lock, [&] { return next_to_write == idx; });
+                if (!failed) {
+                    writer.write_rows(filtered);
+                    if (!writer.good()) failed = true;
+                }
+                next_to_write++;
+                band_written.notify_all();
+            }
+        }
+    }, threads);
+    return !failed && writer.good();
+}
+
+#endif //CV_LESSONS_STREAMING_H
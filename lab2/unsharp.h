@@ -0,0 +1,104 @@
+#ifndef CV_LESSONS_UNSHARP_H
+#define CV_LESSONS_UNSHARP_H
+
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+
+// Fused unsharp masking: dst = saturate(src + alpha * (src - blur(src))) computed row by row.
+// The blur is a separable symmetric kernel applied as a vertical pass into a single float
+// row followed by a horizontal pass, and the difference, scaling and saturation happen on
+// the same row. Nothing full-size is allocated besides dst and nothing is rounded to 8 bits
+// before the final store. Rows are split into bands processed in parallel.
+// Borders are reflected like BORDER_REFLECT_101, the default of filter2D and GaussianBlur.
+
+// Blurs row y of src with the separable kernel into blur, padded is a scratch buffer
+inline void separable_blur_row(const cv::Mat &src, int y, const std::vector<float> &kernel,
+                               std::vector<float> &padded, float *blur) {
+    const int width = src.cols, height = src.rows;
+    const int radius = (int)kernel.size() / 2;
+    const uchar *rows[64];
+    assert(kernel.size() <= 64);
+    padded.resize(width + 2 * radius);
+    float *vertical = padded.data() + radius;
+
+    for (int i = 0; i < (int)kernel.size(); i++) {
+        rows[i] = src.ptr<uchar>(cv::borderInterpolate(y + i - radius, height, cv::BORDER_REFLECT_101));
+    }
+    for (int x = 0; x < width; x++) {
+        vertical[x] = kernel[0] * rows[0][x];
+    }
+    for (int i = 1; i < (int)kernel.size(); i++) {
+        const float k = kernel[i];
+        const uchar *row = rows[i];
+        for (int x = 0; x < width; x++) {
+            vertical[x] += k * row[x];
+        }
+    }
+    for (int j = 1; j <= radius; j++) {
+        vertical[-j] = vertical[cv::borderInterpolate(-j, width, cv::BORDER_REFLECT_101)];
+        vertical[width - 1 + j] = vertical[cv::borderInterpolate(width - 1 + j, width, cv::BORDER_REFLECT_101)];
+    }
+
+    // Taps in the outer loop keep the inner loops straight and vectorizable
+    for (int x = 0; x < width; x++) {
+        blur[x] = kernel[0] * vertical[x - radius];
+    }
+    for (int i = 1; i < (int)kernel.size(); i++) {
+        const float k = kernel[i];
+        const float *shifted = vertical + i - radius;
+        for (int x = 0; x < width; x++) {
+            blur[x] += k * shifted[x];
+        }
+    }
+}
+
+inline void fused_unsharp_rows(const cv::Mat &src, cv::Mat &dst, const std::vector<float> &kernel, float alpha,
+                               int row_begin, int row_end) {
+    const int width = src.cols;
+    std::vector<float> padded, blur(width);
+    for (int y = row_begin; y < row_end; y++) {
+        separable_blur_row(src, y, kernel, padded, blur.data());
+        const uchar *center = src.ptr<uchar>(y);
+        uchar *out = dst.ptr<uchar>(y);
+        for (int x = 0; x < width; x++) {
+            out[x] = cv::saturate_cast<uchar>(center[x] + alpha * (center[x] - blur[x]));
+        }
+    }
+}
+
+inline cv::Mat fused_unsharp(const cv::Mat &img, const std::vector<float> &kernel, float alpha) {
+    assert(!img.empty() && img.type() == CV_8UC1 && kernel.size() % 2 == 1);
+    cv::Mat result(img.size(), img.type());
+    cv::parallel_for_(cv::Range(0, img.rows), [&](const cv::Range &range) {
+        fused_unsharp_rows(img, result, kernel, alpha, range.start, range.end);
+    });
+    return result;
+}
+
+inline std::vector<float> box_kernel_1d(int ksize) {
+    return std::vector<float>(ksize, 1.f / (float)ksize);
+}
+
+inline std::vector<float> gaussian_kernel_1d(int ksize, double sigma = 0) {
+    cv::Mat kernel = cv::getGaussianKernel(ksize, sigma, CV_32F);
+    return {kernel.ptr<float>(), kernel.ptr<float>() + ksize};
+}
+
+inline cv::Mat fused_unsharp_box(const cv::Mat &img, int ksize, double alpha) {
+    return fused_unsharp(img, box_kernel_1d(ksize), (float)alpha);
+}
+
+inline cv::Mat fused_unsharp_gaussian(const cv::Mat &img, int ksize, double alpha) {
+    return fused_unsharp(img, gaussian_kernel_1d(ksize), (float)alpha);
+}
+
+// The Laplace kernel of laplace_filter (all -1, ksize^2 - 1 in the middle) equals
+// ksize^2 * (center - box mean), so img + alpha * laplace is box unsharp masking
+// with alpha scaled by the kernel area
+inline cv::Mat fused_unsharp_laplace(const cv::Mat &img, int ksize, double alpha) {
+    return fused_unsharp(img, box_kernel_1d(ksize), (float)(alpha * ksize * ksize));
+}
+
+#endif //CV_LESSONS_UNSHARP_H
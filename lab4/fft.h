@@ -0,0 +1,584 @@
+#ifndef CV_LESSONS_FFT_H
+#define CV_LESSONS_FFT_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <utility>
+#include <vector>
+#include "opencv2/core.hpp"
+
+
+// Iterative in-place FFT of any size. A plan holds everything that depends only on the
+// size: the factorization into radix 4, 2, 3, 5 and 7 stages, the digit reversal that
+// puts the input in the order the stages expect, stored as swaps, and a table of
+// exp(-2 pi i k / n) computed directly with cos and sin, so no accuracy is lost to
+// repeated multiplication. Each stage combines `radix` neighbouring transforms of length
+// `length` into one of length radix * length by twiddling them and taking a small DFT
+// across them. Sizes with a prime factor above 7 use Bluestein's algorithm instead,
+// a convolution with a chirp computed by a power of two transform, so every size costs
+// O(n log n). Transforms allocate nothing, except that the first Bluestein transform on a
+// thread grows that thread's work buffer, and the inverse scales by 1/n once at the end.
+
+using Complex = std::complex<double>;
+
+// Plain complex product; std::complex operator* also handles inf/nan cases and is far slower
+inline Complex complex_mul(Complex a, Complex b) {
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+// a * -i for the forward transform, a * i for the inverse
+inline Complex rotate_quarter(Complex a, bool inverse) {
+    return inverse ? Complex(-a.imag(), a.real()) : Complex(a.imag(), -a.real());
+}
+
+// Stage radices of n, largest first, or an empty list when n has a prime factor above 7
+inline std::vector<int> fft_radices(size_t n) {
+    std::vector<int> radices;
+    for (int radix: {4, 2, 3, 5, 7}) {
+        while (n % radix == 0) {
+            radices.push_back(radix);
+            n /= radix;
+        }
+    }
+    if (n != 1) radices.clear();
+    std::sort(radices.begin(), radices.end(), std::greater<>());
+    return radices;
+}
+
+// Smallest power of two >= n
+inline size_t fft_size(size_t n) {
+    size_t size = 1;
+    while (size < n) size *= 2;
+    return size;
+}
+
+class FftPlan {
+    size_t n = 0;
+    std::vector<int> radices;                          // in stage order, empty for Bluestein
+    std::vector<std::pair<uint32_t, uint32_t>> swaps;  // digit reversal
+    std::vector<Complex> twiddles;                     // exp(-2 pi i k / n) for k < n
+
+    // Bluestein: X_k = c_k * sum_j x_j c_j conj(c_{k-j}) with the chirp c_k = exp(-i pi k^2 / n)
+    std::vector<Complex> chirp;
+    std::vector<Complex> chirp_spectrum;  // transform of conj(c_k), wrapped to the inner length
+    std::unique_ptr<FftPlan> inner;       // power of two plan of at least 2n - 1 points
+
+public:
+    explicit FftPlan(size_t n);
+
+    size_t size() const { return n; }
+
+    bool bluestein() const { return inner != nullptr; }
+
+    // Transforms n values in place
+    void execute(Complex *data, bool inverse) const;
+
+private:
+    Complex twiddle(size_t k, bool inverse) const { return inverse ? std::conj(twiddles[k]) : twiddles[k]; }
+
+    void radix2_stage(Complex *data, size_t length, bool inverse) const;
+
+    void radix4_stage(Complex *data, size_t length, bool inverse) const;
+
+    template<int R>
+    void odd_radix_stage(Complex *data, size_t length, bool inverse) const;
+
+    void execute_bluestein(Complex *data, bool inverse) const;
+};
+
+
+inline FftPlan::FftPlan(size_t n) : n(n), radices(fft_radices(n)) {
+    assert(n > 0 && n <= (size_t)UINT32_MAX);
+    if (radices.empty() && n > 1) {
+        const size_t m = fft_size(2 * n - 1);
+        inner = std::make_unique<FftPlan>(m);
+        chirp.resize(n);
+        chirp_spectrum.assign(m, 0);
+        for (size_t k = 0; k < n; k++) {
+            // k^2 mod 2n keeps the angle small and exact for large k
+            double angle = -std::numbers::pi * (double)((k * k) % (2 * n)) / (double)n;
+            chirp[k] = {std::cos(angle), std::sin(angle)};
+        }
+        chirp_spectrum[0] = std::conj(chirp[0]);
+        for (size_t k = 1; k < n; k++) {
+            chirp_spectrum[k] = chirp_spectrum[m - k] = std::conj(chirp[k]);
+        }
+        inner->execute(chirp_spectrum.data(), false);
+        return;
+    }
+
+    // The first stage combines the samples whose index agrees in the lowest digit, so sample
+    // i goes to the position whose digits, read in stage order, are i's digits reversed
+    std::vector<uint32_t> target(n);
+    for (size_t i = 0; i < n; i++) {
+        size_t rest = i, position = 0, length = n;
+        for (auto radix = radices.rbegin(); radix != radices.rend(); ++radix) {
+            length /= *radix;
+            position += (rest % *radix) * length;
+            rest /= *radix;
+        }
+        target[i] = (uint32_t)position;
+    }
+    // Follows each cycle of the permutation from its smallest index, which carries the
+    // values along it by swapping
+    std::vector<bool> visited(n, false);
+    for (size_t start = 0; start < n; start++) {
+        if (visited[start]) continue;
+        visited[start] = true;
+        for (size_t i = target[start]; i != start; i = target[i]) {
+            swaps.emplace_back((uint32_t)start, (uint32_t)i);
+            visited[i] = true;
+        }
+    }
+
+    twiddles.resize(n);
+    for (size_t k = 0; k < n; k++) {
+        double angle = -2 * std::numbers::pi * (double)k / (double)n;
+        twiddles[k] = {std::cos(angle), std::sin(angle)};
+    }
+}
+
+inline void FftPlan::radix2_stage(Complex *data, size_t length, bool inverse) const {
+    const size_t span = 2 * length, stride = n / span;
+    for (size_t base = 0; base < n; base += span) {
+        for (size_t j = 0; j < length; j++) {
+            Complex *x = data + base + j;
+            Complex a = x[0], b = complex_mul(x[length], twiddle(j * stride, inverse));
+            x[0] = a + b;
+            x[length] = a - b;
+        }
+    }
+}
+
+inline void FftPlan::radix4_stage(Complex *data, size_t length, bool inverse) const {
+    const size_t span = 4 * length, stride = n / span;
+    for (size_t base = 0; base < n; base += span) {
+        for (size_t j = 0; j < length; j++) {
+            Complex *x = data + base + j;
+            Complex t0 = x[0];
+            Complex t1 = complex_mul(x[length], twiddle(j * stride, inverse));
+            Complex t2 = complex_mul(x[2 * length], twiddle(2 * j * stride, inverse));
+            Complex t3 = complex_mul(x[3 * length], twiddle(3 * j * stride, inverse));
+            Complex even_sum = t0 + t2, even_diff = t0 - t2;
+            Complex odd_sum = t1 + t3, odd_diff = rotate_quarter(t1 - t3, inverse);
+            x[0] = even_sum + odd_sum;
+            x[length] = even_diff + odd_diff;
+            x[2 * length] = even_sum - odd_sum;
+            x[3 * length] = even_diff - odd_diff;
+        }
+    }
+}
+
+// Odd radix DFT from pairs of inputs q and R - q: their sum meets the cosines and their
+// difference the sines, so R = 3, 5 and 7 take 1, 2 and 3 pairs instead of R^2 products
+template<int R>
+inline void FftPlan::odd_radix_stage(Complex *data, size_t length, bool inverse) const {
+    constexpr int H = (R - 1) / 2;
+    double cosines[R], sines[R];
+    for (int m = 0; m < R; m++) {
+        cosines[m] = std::cos(2 * std::numbers::pi * m / R);
+        sines[m] = std::sin(2 * std::numbers::pi * m / R);
+    }
+    const size_t span = R * length, stride = n / span;
+    for (size_t base = 0; base < n; base += span) {
+        for (size_t j = 0; j < length; j++) {
+            Complex *x = data + base + j;
+            Complex t[R], sums[H + 1], diffs[H + 1];
+            t[0] = x[0];
+            for (int q = 1; q < R; q++) {
+                t[q] = complex_mul(x[q * length], twiddle(q * j * stride, inverse));
+            }
+            Complex dc = t[0];
+            for (int q = 1; q <= H; q++) {
+                sums[q] = t[q] + t[R - q];
+                diffs[q] = t[q] - t[R - q];
+                dc += sums[q];
+            }
+            x[0] = dc;
+            for (int k = 1; k <= H; k++) {
+                Complex real_part = t[0], imag_part = 0;
+                for (int q = 1; q <= H; q++) {
+                    real_part += sums[q] * cosines[q * k % R];
+                    imag_part += diffs[q] * sines[q * k % R];
+                }
+                Complex rotated = rotate_quarter(imag_part, inverse);
+                x[k * length] = real_part + rotated;
+                x[(R - k) * length] = real_part - rotated;
+            }
+        }
+    }
+}
+
+// The inverse uses idft(x) = conj(dft(conj(x))) / n
+inline void FftPlan::execute_bluestein(Complex *data, bool inverse) const {
+    const size_t m = inner->size();
+    thread_local std::vector<Complex> work;
+    work.assign(m, 0);
+    for (size_t k = 0; k < n; k++) {
+        work[k] = complex_mul(inverse ? std::conj(data[k]) : data[k], chirp[k]);
+    }
+    inner->execute(work.data(), false);
+    for (size_t k = 0; k < m; k++) work[k] = complex_mul(work[k], chirp_spectrum[k]);
+    inner->execute(work.data(), true);
+    const double scale = inverse ? 1.0 / (double)n : 1.0;
+    for (size_t k = 0; k < n; k++) {
+        Complex value = complex_mul(work[k], chirp[k]);
+        data[k] = (inverse ? std::conj(value) : value) * scale;
+    }
+}
+
+inline void FftPlan::execute(Complex *data, bool inverse) const {
+    if (bluestein()) {
+        execute_bluestein(data, inverse);
+        return;
+    }
+    for (auto [i, j]: swaps) std::swap(data[i], data[j]);
+
+    size_t length = 1;
+    for (int radix: radices) {
+        switch (radix) {
+            case 2: radix2_stage(data, length, inverse); break;
+            case 3: odd_radix_stage<3>(data, length, inverse); break;
+            case 4: radix4_stage(data, length, inverse); break;
+            case 5: odd_radix_stage<5>(data, length, inverse); break;
+            default: odd_radix_stage<7>(data, length, inverse); break;
+        }
+        length *= radix;
+    }
+
+    if (inverse) {
+        const double scale = 1.0 / (double)n;
+        for (size_t i = 0; i < n; i++) data[i] *= scale;
+    }
+}
+
+
+// Rough cost of a transform in units of a radix-2 butterfly per point: each stage costs
+// n times a per-radix weight, Bluestein three power of two transforms plus the chirp
+// products. Only the ratios matter, they choose between sizes.
+inline double fft_cost(size_t n) {
+    std::vector<int> radices = fft_radices(n);
+    if (radices.empty() && n > 1) {
+        size_t m = fft_size(2 * n - 1);
+        return 3 * fft_cost(m) + 4.0 * (double)m;
+    }
+    double per_point = 0;
+    for (int radix: radices) {
+        per_point += radix == 2 ? 1.0 : radix == 4 ? 1.7 : radix == 3 ? 1.8 : radix == 5 ? 2.9 : 4.0;
+    }
+    return (double)n * std::max(per_point, 1.0);
+}
+
+// Transform length for data of n samples that may be zero padded, as for convolution: n
+// itself when it transforms cheaply, otherwise the cheapest padded length. Lengths past
+// the next power of two never pay off.
+inline int fft_good_size(int n) {
+    int best = n;
+    double best_cost = fft_cost(n);
+    for (int m = n + 1; m <= (int)fft_size(n); m++) {
+        double cost = fft_cost(m);
+        if (cost < best_cost) {
+            best = m;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+
+// Plans are built once per size and shared, execute is const and safe to call concurrently
+inline const FftPlan &fft_plan(size_t n) {
+    static std::mutex mutex;
+    static std::map<size_t, std::unique_ptr<FftPlan>> plans;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<FftPlan> &plan = plans[n];
+    if (!plan) plan = std::make_unique<FftPlan>(n);
+    return *plan;
+}
+
+inline void fft_inplace(std::vector<Complex> &data, bool inverse) {
+    fft_plan(data.size()).execute(data.data(), inverse);
+}
+
+// Real input transforms. The spectrum of n real samples is Hermitian, X(n - k) =
+// conj(X(k)), so only X(0..n/2) is kept. For even n the samples are packed into n/2
+// complex values z_k = x_2k + i x_2k+1, one complex transform of n/2 points gives the
+// spectra E and O of the even and odd samples together, and X_k = E_k + W^k O_k
+// untangles them in place: half the work and memory of a complex transform. Odd n goes
+// through a complex transform in a per-thread buffer.
+class RealFftPlan {
+    size_t n = 0;
+    const FftPlan *half = nullptr;  // n/2 points for even n
+    const FftPlan *full = nullptr;  // n points for odd n
+    std::vector<Complex> twiddles;  // exp(-2 pi i k / n) for k <= n/2
+
+public:
+    explicit RealFftPlan(size_t n);
+
+    size_t size() const { return n; }
+
+    // n real samples to the n/2 + 1 spectrum values
+    void forward(const double *src, Complex *dst) const;
+
+    // n/2 + 1 spectrum values to n real samples, scaled by 1/n
+    void inverse(const Complex *src, double *dst) const;
+};
+
+
+inline RealFftPlan::RealFftPlan(size_t n) : n(n) {
+    assert(n > 0);
+    if (n % 2 == 1) {
+        full = &fft_plan(n);
+        return;
+    }
+    half = &fft_plan(n / 2);
+    twiddles.resize(n / 2 + 1);
+    for (size_t k = 0; k <= n / 2; k++) {
+        double angle = -2 * std::numbers::pi * (double)k / (double)n;
+        twiddles[k] = {std::cos(angle), std::sin(angle)};
+    }
+}
+
+inline void RealFftPlan::forward(const double *src, Complex *dst) const {
+    if (full) {
+        thread_local std::vector<Complex> work;
+        work.resize(n);
+        for (size_t i = 0; i < n; i++) work[i] = {src[i], 0};
+        full->execute(work.data(), false);
+        std::copy(work.begin(), work.begin() + (ptrdiff_t)(n / 2 + 1), dst);
+        return;
+    }
+    const size_t h = n / 2;
+    for (size_t k = 0; k < h; k++) dst[k] = {src[2 * k], src[2 * k + 1]};
+    half->execute(dst, false);
+    dst[h] = dst[0];  // z is periodic in h
+
+    // E_k = (Z_k + conj(Z_h-k)) / 2 and O_k = (Z_k - conj(Z_h-k)) / 2i; for h - k they are
+    // the conjugates, so k and h - k are done together from the values read before
+    for (size_t k = 0; k <= h / 2; k++) {
+        const size_t l = h - k;
+        Complex zk = dst[k], zl = dst[l];
+        Complex even = (zk + std::conj(zl)) * 0.5, odd = rotate_quarter(zk - std::conj(zl), false) * 0.5;
+        dst[k] = even + complex_mul(twiddles[k], odd);
+        dst[l] = std::conj(even) + complex_mul(twiddles[l], std::conj(odd));
+    }
+}
+
+inline void RealFftPlan::inverse(const Complex *src, double *dst) const {
+    if (full) {
+        thread_local std::vector<Complex> work;
+        work.resize(n);
+        work[0] = src[0];
+        for (size_t k = 1; k <= n / 2; k++) {
+            work[k] = src[k];
+            work[n - k] = std::conj(src[k]);
+        }
+        full->execute(work.data(), true);
+        for (size_t i = 0; i < n; i++) dst[i] = work[i].real();
+        return;
+    }
+    // The reverse of forward: Z_k = E_k + i O_k is built straight in dst, whose n doubles
+    // are the h packed complex values; the inverse transform's 1/h is the 1/n of the real one
+    const size_t h = n / 2;
+    Complex *z = reinterpret_cast<Complex *>(dst);
+    for (size_t k = 0; k < h; k++) {
+        Complex xk = src[k], xl = std::conj(src[h - k]);
+        Complex even = (xk + xl) * 0.5, odd = complex_mul(xk - xl, std::conj(twiddles[k])) * 0.5;
+        z[k] = even + rotate_quarter(odd, true);
+    }
+    half->execute(z, true);
+}
+
+inline const RealFftPlan &real_fft_plan(size_t n) {
+    static std::mutex mutex;
+    static std::map<size_t, std::unique_ptr<RealFftPlan>> plans;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<RealFftPlan> &plan = plans[n];
+    if (!plan) plan = std::make_unique<RealFftPlan>(n);
+    return *plan;
+}
+
+// Padded length for real data: even lengths take the half length complex transform
+inline int rfft_good_size(int n) {
+    auto cost = [](int m) { return m % 2 == 0 ? fft_cost(m / 2) + 2.0 * m : fft_cost(m) + 2.0 * m; };
+    int best = n;
+    double best_cost = cost(n);
+    for (int m = n + 1; m <= (int)fft_size(n); m++) {
+        if (cost(m) < best_cost) {
+            best = m;
+            best_cost = cost(m);
+        }
+    }
+    return best;
+}
+
+
+
+
+// 2D transforms of CV_64FC2 matrices of any size. Rows are transformed in
+// place, the matrix is transposed so that its columns become contiguous rows, those are
+// transformed and the result is transposed back. Both the row batches and the transpose
+// tiles are spread over cv::parallel_for_.
+
+// Transforms every row of data in place
+inline void fft_rows(cv::Mat &data, bool inverse) {
+    assert(data.type() == CV_64FC2);
+    const FftPlan &plan = fft_plan(data.cols);
+    cv::parallel_for_(cv::Range(0, data.rows), [&](const cv::Range &range) {
+        for (int y = range.start; y < range.end; y++) {
+            plan.execute(data.ptr<Complex>(y), inverse);
+        }
+    });
+}
+
+// dst = src^T in 32 x 32 tiles, 16 KB per tile and its image, so both stay in L1
+inline void transpose_blocked(const cv::Mat &src, cv::Mat &dst) {
+    assert(src.type() == CV_64FC2);
+    constexpr int TILE = 32;
+    dst.create(src.cols, src.rows, src.type());
+    const int tile_rows = (src.rows + TILE - 1) / TILE;
+    cv::parallel_for_(cv::Range(0, tile_rows), [&](const cv::Range &range) {
+        for (int tile = range.start; tile < range.end; tile++) {
+            const int y_begin = tile * TILE, y_end = std::min(src.rows, y_begin + TILE);
+            for (int x_begin = 0; x_begin < src.cols; x_begin += TILE) {
+                const int x_end = std::min(src.cols, x_begin + TILE);
+                for (int y = y_begin; y < y_end; y++) {
+                    const Complex *in = src.ptr<Complex>(y);
+                    for (int x = x_begin; x < x_end; x++) dst.ptr<Complex>(x)[y] = in[x];
+                }
+            }
+        }
+    });
+}
+
+// In place 2D transform, the inverse is scaled by 1 / (rows * cols).
+// scratch holds the transposed matrix and can be reused between calls.
+inline void fft2d_inplace(cv::Mat &data, bool inverse, cv::Mat &scratch) {
+    fft_rows(data, inverse);
+    transpose_blocked(data, scratch);
+    fft_rows(scratch, inverse);
+    transpose_blocked(scratch, data);
+}
+
+// Spectrum of a real single channel image or a CV_64FC2 complex one, as CV_64FC2.
+// The result matches cv::dft with DFT_COMPLEX_OUTPUT
+// and, for the inverse, DFT_SCALE.
+inline cv::Mat fft2d(const cv::Mat &image, bool inverse = false) {
+    assert(!image.empty() && (image.channels() == 1 || image.channels() == 2));
+    cv::Mat data, scratch;
+    if (image.channels() == 2) {
+        image.convertTo(data, CV_64F);
+    } else {
+        cv::Mat real;
+        image.convertTo(real, CV_64F);
+        data.create(image.size(), CV_64FC2);
+        cv::parallel_for_(cv::Range(0, image.rows), [&](const cv::Range &range) {
+            for (int y = range.start; y < range.end; y++) {
+                const double *in = real.ptr<double>(y);
+                Complex *out = data.ptr<Complex>(y);
+                for (int x = 0; x < image.cols; x++) out[x] = {in[x], 0};
+            }
+        });
+    }
+    fft2d_inplace(data, inverse, scratch);
+    return data;
+}
+
+// Half spectrum of a real single channel image: rows x (cols / 2 + 1) CV_64FC2 values,
+// the rest follow from X(y, x) = conj(X(-y, -x)). Rows go through the real transform,
+// the columns of the half width result through the complex one.
+inline cv::Mat rfft2d(const cv::Mat &image) {
+    assert(!image.empty() && image.channels() == 1);
+    cv::Mat real, scratch;
+    image.convertTo(real, CV_64F);
+    cv::Mat spectrum(image.rows, image.cols / 2 + 1, CV_64FC2);
+    const RealFftPlan &plan = real_fft_plan(image.cols);
+    cv::parallel_for_(cv::Range(0, image.rows), [&](const cv::Range &range) {
+        for (int y = range.start; y < range.end; y++) {
+            plan.forward(real.ptr<double>(y), spectrum.ptr<Complex>(y));
+        }
+    });
+    transpose_blocked(spectrum, scratch);
+    fft_rows(scratch, false);
+    transpose_blocked(scratch, spectrum);
+    return spectrum;
+}
+
+// Real CV_64FC1 image of `cols` columns from its half spectrum, scaled like DFT_SCALE
+inline cv::Mat irfft2d(const cv::Mat &spectrum, int cols) {
+    assert(spectrum.type() == CV_64FC2 && spectrum.cols == cols / 2 + 1);
+    cv::Mat columns, scratch;
+    transpose_blocked(spectrum, scratch);
+    fft_rows(scratch, true);
+    transpose_blocked(scratch, columns);
+    cv::Mat image(spectrum.rows, cols, CV_64F);
+    const RealFftPlan &plan = real_fft_plan(cols);
+    cv::parallel_for_(cv::Range(0, image.rows), [&](const cv::Range &range) {
+        for (int y = range.start; y < range.end; y++) {
+            plan.inverse(columns.ptr<Complex>(y), image.ptr<double>(y));
+        }
+    });
+    return image;
+}
+
+// The real row transforms of src zero padded to size, stored transposed: row u of the
+// (size.width / 2 + 1) x size.height result holds frequency column u of every row's half
+// spectrum, ready for the column transforms. Rows past src.rows are zero and skipped.
+inline void rfft_rows_transposed(const cv::Mat &src, cv::Size size, cv::Mat &dst) {
+    assert(src.channels() == 1 && src.rows <= size.height && src.cols <= size.width);
+    const int n = size.width, half = n / 2 + 1;
+    cv::Mat real, rows(src.rows, half, CV_64FC2);
+    src.convertTo(real, CV_64F);
+    const RealFftPlan &plan = real_fft_plan(n);
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range &range) {
+        thread_local std::vector<double> padded;
+        for (int y = range.start; y < range.end; y++) {
+            padded.assign(n, 0.0);
+            std::copy(real.ptr<double>(y), real.ptr<double>(y) + src.cols, padded.begin());
+            plan.forward(padded.data(), rows.ptr<Complex>(y));
+        }
+    });
+    dst = cv::Mat::zeros(half, size.height, CV_64FC2);
+    cv::Mat filled = dst(cv::Rect(0, 0, src.rows, half));
+    transpose_blocked(rows, filled);
+}
+
+// The full rows x cols spectrum from a half one, for display
+inline cv::Mat expand_half_spectrum(const cv::Mat &half, int cols) {
+    assert(half.type() == CV_64FC2 && half.cols == cols / 2 + 1);
+    cv::Mat full(half.rows, cols, CV_64FC2);
+    for (int y = 0; y < half.rows; y++) {
+        const Complex *mirror = half.ptr<Complex>((half.rows - y) % half.rows);
+        Complex *out = full.ptr<Complex>(y);
+        std::copy(half.ptr<Complex>(y), half.ptr<Complex>(y) + half.cols, out);
+        for (int x = half.cols; x < cols; x++) out[x] = std::conj(mirror[cols - x]);
+    }
+    return full;
+}
+
+// Element-wise a * b, or a * conj(b) for correlation, of full or half CV_64FC2 spectra
+inline cv::Mat multiply_spectrums(const cv::Mat &a, const cv::Mat &b, bool conjugate_b = false) {
+    assert(a.type() == CV_64FC2 && b.type() == CV_64FC2 && a.size() == b.size());
+    cv::Mat result(a.size(), CV_64FC2);
+    cv::parallel_for_(cv::Range(0, a.rows), [&](const cv::Range &range) {
+        const int width = a.cols;
+        for (int y = range.start; y < range.end; y++) {
+            const Complex *pa = a.ptr<Complex>(y), *pb = b.ptr<Complex>(y);
+            Complex *out = result.ptr<Complex>(y);
+            for (int x = 0; x < width; x++) {
+                out[x] = complex_mul(pa[x], conjugate_b ? std::conj(pb[x]) : pb[x]);
+            }
+        }
+    });
+    return result;
+}
+
+#endif //CV_LESSONS_FFT_H
@@ -0,0 +1,266 @@
+#ifndef CV_LESSONS_FOURIER_H
+#define CV_LESSONS_FOURIER_H
+
+#include <opencv2/opencv.hpp>
+#include <complex>
+#include <vector>
+
+#include "fft.h"
+
+#define PI 3.14159265354
+
+
+inline cv::Mat dft(cv::Mat& image) {
+    int M = image.rows;
+    int N = image.cols;
+    cv::Mat res(M, N, CV_64FC2);
+    for (int k = 0; k < M; k++) {
+        for (int l = 0; l < N; l++) {
+            std::complex<double> Fkl(0, 0);
+            for (int i = 0; i < M; i++) {
+                for (int j = 0; j < N; j++) {
+                    Fkl += (double)image.at<uint8_t>(i, j) *
+                            std::exp(std::complex<double>(0, -2 * PI * (k * i / (double)M + l * j / (double)N)));
+                }
+            }
+            res.at<std::complex<double>>(k, l) = Fkl;
+        }
+    }
+    return res;
+}
+
+inline cv::Mat idft(cv::Mat src) {
+    int M = src.rows;
+    int N = src.cols;
+    cv::Mat res(M, N, CV_64F);
+
+    for (int k = 0; k < M; k++) {
+        for (int l = 0; l < N; l++) {
+            double fkl = 0;
+            for (int i = 0; i < M; i++) {
+                for (int j = 0; j < N; j++) {
+                    std::complex<double> Fij = src.at<std::complex<double>>(i, j);
+                    std::complex<double> exp_term = exp(std::complex<double>(0, 2 * PI * (i * k / double(M) + j * l / double(N))));
+                    fkl += Fij.real() * exp_term.real() - Fij.imag() * exp_term.imag();
+                }
+            }
+            res.at<double>(k, l) = fkl / (M * N);
+        }
+    }
+    res.convertTo(res, CV_8U);
+    return res;
+}
+
+inline void dft_shuffle(cv::Mat& src) {
+    int cx = src.cols / 2;
+    int cy = src.rows / 2;
+    cv::Mat q0(src, cv::Rect(0, 0, cx, cy)); // Левый верхний угол
+    cv::Mat q1(src, cv::Rect(cx, 0, cx, cy)); // Правый верхний угол
+    cv::Mat q2(src, cv::Rect(0, cy, cx, cy)); // Левый нижний угол
+    cv::Mat q3(src, cv::Rect(cx, cy, cx, cy)); // Правый нижний угол
+    cv::Mat tmp;
+    q0.copyTo(tmp);
+    q3.copyTo(q0);
+    tmp.copyTo(q3);
+    q1.copyTo(tmp);
+    q2.copyTo(q1);
+    tmp.copyTo(q2);
+}
+
+inline cv::Mat display_magnitude(cv::Mat image) {
+    cv::Mat planes[2], magnitude;
+    cv::split(image, planes);
+    cv::magnitude(planes[0], planes[1], magnitude);
+    cv::log(magnitude + cv::Scalar::all(1), magnitude);
+    dft_shuffle(magnitude);
+    cv::normalize(magnitude, magnitude, 0, 1, cv::NORM_MINMAX);
+    return magnitude;
+}
+
+inline std::vector<std::complex<double>> mat2vec(cv::Mat image) {
+    std::vector<uchar> imageVector(image.begin<uint8_t>(), image.end<uint8_t>());
+    std::vector<std::complex<double>> complexVector(imageVector.size());
+    for (int idx = 0; idx < imageVector.size(); idx++)
+        complexVector[idx] = std::complex<double>(imageVector[idx], 0);
+    return complexVector;
+}
+
+inline cv::Mat vec2mat(const std::vector<std::complex<double>> &complexVector, cv::Size size) {
+    cv::Mat resultMat(size, CV_64FC2);
+    for (int i = 0; i < size.height; ++i)
+        for (int j = 0; j < size.width; ++j)
+            resultMat.at<cv::Vec2d>(i, j) = {complexVector[i * size.width + j].real(), complexVector[i * size.width + j].imag()};
+    return resultMat;
+}
+
+
+// The original recursive FFT, kept as the benchmark baseline. It allocates at every level
+// and its inverse divides by N at every level, so only the forward transform is right.
+inline void fft_radix2_recursive(std::vector<std::complex<double>> &src, std::vector<std::complex<double>> &res,
+                                 bool inverse) {
+    size_t N = src.size();
+    if (N == 1) {
+        res = src;
+        return;
+    }
+    std::vector<std::complex<double>> y_even, y_odd;
+    y_even.resize(N / 2);
+    y_odd.resize(N / 2);
+    for (int i = 0; i < N / 2; ++i) {
+        y_even[i] = src[2 * i];
+        y_odd[i] = src[2 * i + 1];
+    }
+
+    fft_radix2_recursive(y_even, y_even, inverse);
+    fft_radix2_recursive(y_odd, y_odd, inverse);
+
+    res.resize(N);
+    std::complex<double> wn(cos(2 * PI / (double)N), sin(2 * PI / (double)N) * (inverse ? 1 : -1));
+    std::complex<double> w(1);
+    for (int i = 0; i < N / 2; ++i) {
+        res[i] = y_even[i] + w * y_odd[i];
+        res[i + N / 2] = y_even[i] - w * y_odd[i];
+        w *= wn;
+    }
+
+    if (inverse) {
+        for (int i = 0; i < N; ++i) {
+            res[i] /= (double)N;
+        }
+    }
+}
+
+// Any src.size(); res is reused, so repeated calls do not allocate
+inline void fft_radix2(const std::vector<std::complex<double>> &src, std::vector<std::complex<double>> &res,
+                       bool inverse) {
+    res.assign(src.begin(), src.end());
+    fft_inplace(res, inverse);
+}
+
+
+// Size of the zero padded transforms for the full convolution of image and kernel: padding
+// to any size that covers it is exact, the planner picks the cheapest one, which may be
+// the native size. Columns favour even sizes, which take the half length real transform.
+inline cv::Size convolution_size(const cv::Mat &image, const cv::Mat &kernel) {
+    return {rfft_good_size(image.cols + kernel.cols - 1), fft_good_size(image.rows + kernel.rows - 1)};
+}
+
+// Half spectrum of image * kernel, both zero padded to size
+inline cv::Mat convolution(const cv::Mat &image, const cv::Mat &kernel, cv::Size size)
+{
+    cv::Mat padded_image, padded_kernel;
+    copyMakeBorder(image, padded_image, 0, size.height - image.rows, 0, size.width - image.cols, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+    copyMakeBorder(kernel, padded_kernel, 0, size.height - kernel.rows, 0, size.width - kernel.cols, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+
+    return multiply_spectrums(rfft2d(padded_image), rfft2d(padded_kernel));
+}
+
+// The image behind a half spectrum of `cols` columns, stretched to 0..255
+inline cv::Mat reconstruct(const cv::Mat &half_spectrum, int cols) {
+    cv::Mat result = irfft2d(half_spectrum, cols);
+    normalize(result, result, 0, 255, cv::NORM_MINMAX);
+    result.convertTo(result, CV_8U);
+    return result;
+}
+
+inline cv::Mat reconstruct(cv::Mat src) {
+    cv::Mat result;
+    cv::extractChannel(fft2d(src, true), result, 0);
+    normalize(result, result, 0, 255, cv::NORM_MINMAX);
+    result.convertTo(result, CV_8U);
+    return result;
+}
+
+
+inline cv::Mat high_low_filter(const cv::Mat& input_image, double ratio, bool highPass = false) {
+    cv::Mat result = input_image.clone();
+    cv::Size size = input_image.size();
+    cv::Point center(size.width / 2, size.height / 2);
+    double radius = std::min(size.width, size.height) * ratio;
+
+    for (int y = 0; y < size.height; ++y) {
+        for (int x = 0; x < size.width; ++x) {
+            auto& pixel = result.at<cv::Vec2d>(y, x);
+            double distance = cv::norm(cv::Point(x, y) - center);
+            if ((highPass && distance <= radius) || (!highPass && distance > radius)) pixel = {0, 0};
+        }
+    }
+    return result;
+}
+
+
+// Correlation of one search image with any number of templates. The image is transformed
+// once, at its own size: a valid position plus the template never reaches past the image,
+// so the circular correlation needs no padding for the template. Its half spectrum is kept
+// transposed, one frequency column per row, which is the layout the column transforms
+// work in. A template costs row transforms of its own rows only, then one pass per
+// frequency column that transforms it, multiplies the image by its conjugate and
+// transforms back while the row is in cache, and finally inverse row transforms of the
+// valid output rows only. Plans come from the per-size caches, so they are shared by
+// every matcher and template of the same size.
+class TemplateMatcher {
+    cv::Size image_size;
+    cv::Size size;          // transform size
+    cv::Mat image_columns;  // transposed half spectrum of the image
+
+public:
+    explicit TemplateMatcher(const cv::Mat &image);
+
+    // Same layout as correlation(): valid positions, shifted by half the template
+    cv::Mat correlate(const cv::Mat &templ) const;
+
+    std::vector<cv::Mat> correlate(const std::vector<cv::Mat> &templates) const;
+};
+
+
+inline TemplateMatcher::TemplateMatcher(const cv::Mat &image) : image_size(image.size()) {
+    size = {rfft_good_size(image.cols), fft_good_size(image.rows)};
+    rfft_rows_transposed(image, size, image_columns);
+    fft_rows(image_columns, false);
+}
+
+inline cv::Mat TemplateMatcher::correlate(const cv::Mat &templ) const {
+    assert(templ.rows < image_size.height && templ.cols < image_size.width);
+    cv::Mat columns, rows;
+    rfft_rows_transposed(templ, size, columns);
+    const FftPlan &plan = fft_plan(size.height);
+    cv::parallel_for_(cv::Range(0, columns.rows), [&](const cv::Range &range) {
+        const int length = size.height;
+        for (int u = range.start; u < range.end; u++) {
+            Complex *spectrum = columns.ptr<Complex>(u);
+            const Complex *image_spectrum = image_columns.ptr<Complex>(u);
+            plan.execute(spectrum, false);
+            for (int v = 0; v < length; v++) {
+                spectrum[v] = complex_mul(image_spectrum[v], std::conj(spectrum[v]));
+            }
+            plan.execute(spectrum, true);
+        }
+    });
+    transpose_blocked(columns, rows);
+
+    cv::Mat result(image_size.height - templ.rows, image_size.width - templ.cols, CV_64F);
+    const RealFftPlan &real_plan = real_fft_plan(size.width);
+    cv::parallel_for_(cv::Range(0, result.rows), [&](const cv::Range &range) {
+        thread_local std::vector<double> line;
+        for (int y = range.start; y < range.end; y++) {
+            line.resize(size.width);
+            real_plan.inverse(rows.ptr<Complex>(y), line.data());
+            std::copy(line.begin(), line.begin() + result.cols, result.ptr<double>(y));
+        }
+    });
+    cv::copyMakeBorder(result, result, templ.rows / 2, 0, templ.cols / 2, 0, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+    return result;
+}
+
+inline std::vector<cv::Mat> TemplateMatcher::correlate(const std::vector<cv::Mat> &templates) const {
+    std::vector<cv::Mat> results;
+    for (const cv::Mat &templ: templates) results.push_back(correlate(templ));
+    return results;
+}
+
+
+inline void correlation(const cv::Mat& img, const cv::Mat& templ, cv::Mat& result) {
+    result = TemplateMatcher(img).correlate(templ);
+}
+
+#endif //CV_LESSONS_FOURIER_H